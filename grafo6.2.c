@@ -18,11 +18,41 @@
  */
 
 
+// el servidor de consultas usa interfaces de POSIX y de Linux (lstat(), accept4(), epoll...) que
+// los encabezados sólo declaran si se piden; con -std=c11 no se piden solas
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <float.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
 
 #include "List.h"
 
@@ -30,6 +60,9 @@
 // Esta versión no borra elementos
 // Esta versión no modifica los datos originales
 
+// Los algoritmos marcados como paralelos usan OpenMP; compila con -fopenmp para activarlo.
+// Sin esa opción los pragmas se ignoran y los algoritmos corren en un solo hilo.
+
 #ifndef DBG_HELP
 #define DBG_HELP 0
 #endif  
@@ -69,8 +102,29 @@ typedef struct
     char city[65];
     char name[65];
     int utc_time;
+    float latitude;  ///< en grados, positiva al norte del ecuador
+    float longitude; ///< en grados, positiva al este de Greenwich
 } Airport;
 
+/**
+ * @brief Información de un aeropuerto tal como se guarda en el grafo.
+ *
+ * Las cadenas largas se guardan una sola vez en el almacén de cadenas del grafo y aquí sólo
+ * queda su identificador; se obtienen con Graph_GetString(). Así el vértice ocupa unos cuantos
+ * bytes en lugar de más de 200, y un país compartido por miles de aeropuertos se guarda una vez.
+ */
+typedef struct
+{
+    int id;
+    char iata_code[4];
+    uint32_t country; ///< identificador en el almacén de cadenas
+    uint32_t city;    ///< identificador en el almacén de cadenas
+    uint32_t name;    ///< identificador en el almacén de cadenas
+    int utc_time;
+    float latitude;
+    float longitude;
+} AirportInfo;
+
 typedef struct
 {
     Item data; 
@@ -78,7 +132,9 @@ typedef struct
     eGraphColors color;
     int distance;
     int predecessor;
-    Airport airport_info;
+    AirportInfo airport_info;
+    const Data* in_cursor; ///< cursor sobre las aristas de entrada; ver Vertex_InStart()
+    const Data* in_end;
 } Vertex;
 
 
@@ -169,6 +225,48 @@ typedef enum
    eGraphType_DIRECTED    ///< grafo dirigido (digraph)
 } eGraphType; 
 
+/**
+ * @brief Representación compacta (CSR, compressed sparse row) de las listas de adyacencia.
+ *
+ * Los vecinos del vértice i están en adj[ start[ i ] ], ..., adj[ start[ i + 1 ] - 1 ]. Los
+ * algoritmos de recorrido la prefieren a las listas ligadas porque los vecinos quedan contiguos
+ * en memoria.
+ */
+typedef struct
+{
+   int* start; ///< n + 1 desplazamientos dentro de |adj|
+   Data* adj;  ///< vecinos (índice y peso) de todos los vértices, uno tras otro
+   int n;      ///< número de vértices
+   int m;      ///< número de aristas dirigidas
+} CSR;
+
+/**
+ * @brief Almacén de cadenas sin repetidos (interning).
+ *
+ * Las cadenas se guardan una tras otra, terminadas en '\0', en un solo bloque de memoria; el
+ * identificador de una cadena es su desplazamiento dentro del bloque. El identificador 0 es la
+ * cadena vacía.
+ */
+typedef struct
+{
+   char* arena;     ///< las cadenas, una tras otra
+   uint32_t len;    ///< bytes usados de |arena|
+   uint32_t cap;    ///< bytes reservados de |arena|
+   uint32_t* slots; ///< tabla hash de identificadores + 1; 0 es casilla vacía
+   uint32_t mask;   ///< número de casillas menos 1 (es potencia de 2)
+   uint32_t count;  ///< número de cadenas distintas
+} StringPool;
+
+/**
+ * @brief Un camino en el grafo.
+ */
+typedef struct
+{
+   int* vertices; ///< índices de los vértices, desde el origen hasta el destino
+   int len;       ///< número de vértices en el camino
+   float cost;    ///< suma de los pesos de las aristas del camino
+} Path;
+
 /**
  * @brief Declara lo que es un grafo.
  */
@@ -185,6 +283,32 @@ typedef struct
    int len;  
 
    eGraphType type; ///< tipo del grafo, UNDIRECTED o DIRECTED
+
+   /**
+    * Índices CSR de las aristas de salida y de entrada. Se construyen bajo demanda y se
+    * descartan cada vez que se inserta una arista.
+    */
+   CSR* out;
+   CSR* in;
+
+   struct Search* search; ///< memoria de trabajo de las búsquedas; se crea bajo demanda
+
+   /**
+    * Tabla hash (direccionamiento abierto) de llave a índice, para que buscar un vértice por su
+    * dato no cueste un recorrido de toda la lista. Cada casilla guarda índice + 1; 0 es vacía.
+    */
+   int* keys;
+   int keys_mask; ///< número de casillas menos 1 (es potencia de 2)
+
+   uint64_t version; ///< cambia cada vez que cambian los vértices, las aristas o sus pesos
+
+   StringPool strings; ///< país, ciudad y nombre de los aeropuertos
+
+   /**
+    * Índice + 1 del vértice de cada código IATA de tres letras (A-Z), indexado directamente
+    * por el código visto como número en base 26; 0 indica que no existe.
+    */
+   int* iata;
 } Graph;
 
 //----------------------------------------------------------------------
@@ -205,6 +329,171 @@ static int find( Vertex vertices[], int size, int key )
    return -1;
 }
 
+static inline unsigned hash_key( int key )
+{
+   return (unsigned) key * 2654435769u;
+}
+
+// registra la llave del vértice con índice |idx| en la tabla hash del grafo
+static void key_index_add( Graph* g, int idx )
+{
+   if( !g->keys ) return;
+
+   int key = g->vertices[ idx ].data;
+   for( unsigned h = hash_key( key ) & g->keys_mask; ; h = ( h + 1 ) & g->keys_mask )
+   {
+      if( g->keys[ h ] == 0 )
+      {
+         g->keys[ h ] = idx + 1;
+         return;
+      }
+      if( g->vertices[ g->keys[ h ] - 1 ].data == key ) return;
+      // llave repetida: como find(), nos quedamos con la primera
+   }
+}
+
+// como find(), pero usando la tabla hash del grafo cuando existe
+static int find_key( const Graph* g, int key )
+{
+   if( !g->keys ) return find( g->vertices, g->size, key );
+
+   for( unsigned h = hash_key( key ) & g->keys_mask; g->keys[ h ] != 0; h = ( h + 1 ) & g->keys_mask )
+   {
+      if( g->vertices[ g->keys[ h ] - 1 ].data == key ) return g->keys[ h ] - 1;
+   }
+
+   return -1;
+}
+
+// número de códigos IATA de tres letras mayúsculas
+#define IATA_CODES ( 26 * 26 * 26 )
+
+// convierte un código IATA de tres letras A-Z en un número entre 0 y IATA_CODES - 1; -1 si
+// el código no es de esa forma
+static inline int iata_number( const char* code )
+{
+   unsigned a = (unsigned char) code[ 0 ] - 'A';
+   unsigned b = (unsigned char) code[ 1 ] - 'A';
+   unsigned c = (unsigned char) code[ 2 ] - 'A';
+   bool valid = ( a < 26 ) & ( b < 26 ) & ( c < 26 ) & ( code[ 3 ] == '\0' );
+
+   return valid ? (int) ( ( a * 26 + b ) * 26 + c ) : -1;
+}
+
+static uint32_t hash_string( const char* str )
+{
+   uint32_t h = 2166136261u;
+   while( *str ) h = ( h ^ (unsigned char) *str++ ) * 16777619u;
+   // FNV-1a
+   return h;
+}
+
+static bool pool_init( StringPool* pool )
+{
+   pool->cap = 1024;
+   pool->len = 1;
+   pool->mask = 255;
+   pool->count = 0;
+   pool->arena = (char*) malloc( pool->cap );
+   pool->slots = (uint32_t*) calloc( pool->mask + 1, sizeof( uint32_t ) );
+
+   if( !pool->arena || !pool->slots )
+   {
+      free( pool->arena );
+      free( pool->slots );
+      pool->arena = NULL;
+      pool->slots = NULL;
+      return false;
+   }
+
+   pool->arena[ 0 ] = '\0';
+   return true;
+}
+
+static void pool_free( StringPool* pool )
+{
+   free( pool->arena );
+   free( pool->slots );
+   pool->arena = NULL;
+   pool->slots = NULL;
+}
+
+// duplica la tabla hash cuando está a la mitad
+static bool pool_grow_slots( StringPool* pool )
+{
+   uint32_t mask = pool->mask * 2 + 1;
+   uint32_t* slots = (uint32_t*) calloc( mask + 1, sizeof( uint32_t ) );
+   if( !slots ) return false;
+
+   for( uint32_t i = 0; i <= pool->mask; ++i )
+   {
+      if( pool->slots[ i ] == 0 ) continue;
+
+      uint32_t h = hash_string( &pool->arena[ pool->slots[ i ] - 1 ] ) & mask;
+      while( slots[ h ] != 0 ) h = ( h + 1 ) & mask;
+      slots[ h ] = pool->slots[ i ];
+   }
+
+   free( pool->slots );
+   pool->slots = slots;
+   pool->mask = mask;
+   return true;
+}
+
+// escribe en |handle| el identificador de |str|, agregándola al almacén si no estaba; false si
+// no hay memoria (el almacén no cambia)
+static bool pool_intern( StringPool* pool, const char* str, uint32_t* handle )
+{
+   if( str[ 0 ] == '\0' )
+   {
+      *handle = 0;
+      return true;
+   }
+   if( !pool->arena ) return false;
+
+   uint32_t h = hash_string( str ) & pool->mask;
+   for( ; pool->slots[ h ] != 0; h = ( h + 1 ) & pool->mask )
+   {
+      if( strcmp( &pool->arena[ pool->slots[ h ] - 1 ], str ) == 0 )
+      {
+         *handle = pool->slots[ h ] - 1;
+         return true;
+      }
+   }
+
+   if( ( pool->count + 1 ) * 2 > pool->mask )
+   {
+      // la tabla nunca pasa de la mitad; si no puede crecer no se inserta, porque llena la
+      // búsqueda lineal no terminaría
+      if( !pool_grow_slots( pool ) ) return false;
+
+      h = hash_string( str ) & pool->mask;
+      while( pool->slots[ h ] != 0 ) h = ( h + 1 ) & pool->mask;
+   }
+
+   uint32_t size = (uint32_t) strlen( str ) + 1;
+   if( pool->len + size > pool->cap )
+   {
+      uint32_t cap = pool->cap;
+      while( pool->len + size > cap ) cap *= 2;
+
+      char* arena = (char*) realloc( pool->arena, cap );
+      if( !arena ) return false;
+
+      pool->arena = arena;
+      pool->cap = cap;
+   }
+
+   *handle = pool->len;
+   memcpy( &pool->arena[ *handle ], str, size );
+   pool->len += size;
+
+   pool->slots[ h ] = *handle + 1;
+   ++pool->count;
+
+   return true;
+}
+
 // busca en la lista de vecinos si el índice del vértice vecino ya se encuentra ahí
 static bool find_neighbor( Vertex* v, int index )
 {
@@ -235,364 +524,7068 @@ static void insert( Vertex* vertex, int index, float weigth )
    else DBG_PRINT( "insert: duplicated index\n" );
 }
 
+static CSR* csr_new( int n, int m )
+{
+   CSR* csr = (CSR*) malloc( sizeof( CSR ) );
+   if( csr )
+   {
+      csr->n = n;
+      csr->m = m;
+      csr->start = (int*) calloc( n + 1, sizeof( int ) );
+      csr->adj = (Data*) malloc( ( m > 0 ? m : 1 ) * sizeof( Data ) );
 
+      if( !csr->start || !csr->adj )
+      {
+         free( csr->start );
+         free( csr->adj );
+         free( csr );
+         csr = NULL;
+      }
+   }
 
-//----------------------------------------------------------------------
-//                     Funciones públicas
-//----------------------------------------------------------------------
+   return csr;
+}
 
+static void csr_delete( CSR** p_csr )
+{
+   if( *p_csr )
+   {
+      free( (*p_csr)->start );
+      free( (*p_csr)->adj );
+      free( *p_csr );
+      *p_csr = NULL;
+   }
+}
 
-/**
- * @brief Crea un nuevo grafo.
- *
- * @param size Número de vértices que tendrá el grafo. Este valor no se puede
- * cambiar luego de haberlo creado.
- *
- * @return Un nuevo grafo.
- *
- * @pre El número de elementos es mayor que 0.
- */
-Graph* Graph_New( int size, eGraphType type )
+static inline int csr_degree( const CSR* csr, int idx )
 {
-   assert( size > 0 );
+   return csr->start[ idx + 1 ] - csr->start[ idx ];
+}
 
-   Graph* g = (Graph*) malloc( sizeof( Graph ) );
-   if( g )
+// copia las listas de vecinos al formato CSR. Recorremos los nodos directamente para no
+// mover el cursor de las listas, que podría estar en uso por el cliente.
+static CSR* csr_from_lists( const Graph* g )
+{
+   int m = 0;
+   for( int i = 0; i < g->len; ++i )
    {
-      g->size = size;
-      g->len = 0;
-      g->type = type;
-
-      g->vertices = (Vertex*) calloc( size, sizeof( Vertex ) );
+      if( g->vertices[ i ].neighbors )
+      {
+         for( Node* it = g->vertices[ i ].neighbors->first; it; it = it->next ) ++m;
+      }
+   }
 
-      if( !g->vertices )
+   CSR* csr = csr_new( g->len, m );
+   if( csr )
+   {
+      int pos = 0;
+      for( int i = 0; i < g->len; ++i )
       {
-         free( g );
-         g = NULL;
+         csr->start[ i ] = pos;
+         if( g->vertices[ i ].neighbors )
+         {
+            for( Node* it = g->vertices[ i ].neighbors->first; it; it = it->next )
+            {
+               csr->adj[ pos++ ] = it->data;
+            }
+         }
       }
+      csr->start[ g->len ] = pos;
    }
 
-   return g;
-   // el cliente es responsable de verificar que el grafo se haya creado correctamente
+   return csr;
 }
 
-void Graph_Delete( Graph** g )
+// construye el índice transpuesto: para cada vértice, quiénes llegan a él
+static CSR* csr_transpose( const CSR* out )
 {
-   assert( *g );
-
-   Graph* graph = *g;
-   // para simplificar la notación 
-
-   for( int i = 0; i < graph->size; ++i )
+   CSR* in = csr_new( out->n, out->m );
+   if( in )
    {
-      Vertex* vertex = &graph->vertices[ i ];
-      // para simplificar la notación. 
-      // La variable |vertex| sólo existe dentro de este for.
+      for( int e = 0; e < out->m; ++e ) ++in->start[ out->adj[ e ].index + 1 ];
+      for( int i = 0; i < out->n; ++i ) in->start[ i + 1 ] += in->start[ i ];
 
-      if( vertex->neighbors )
+      int* pos = (int*) malloc( ( out->n + 1 ) * sizeof( int ) );
+      if( !pos )
       {
-         List_Delete( &(vertex->neighbors) );
+         csr_delete( &in );
+         return NULL;
       }
+      memcpy( pos, in->start, ( out->n + 1 ) * sizeof( int ) );
+
+      for( int u = 0; u < out->n; ++u )
+      {
+         for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+         {
+            Data d = { u, out->adj[ e ].weight };
+            in->adj[ pos[ out->adj[ e ].index ]++ ] = d;
+         }
+      }
+
+      free( pos );
    }
 
-   free( graph->vertices );
-   free( graph );
-   *g = NULL;
+   return in;
 }
 
-void Graph_Print(Graph* g, int depth)
+// devuelve el índice CSR de aristas de salida, construyéndolo si hace falta
+static const CSR* out_edges( Graph* g )
 {
-    for (int i = 0; i < g->len; ++i)
-    {
-        Vertex* vertex = &g->vertices[i];
+   if( !g->out ) g->out = csr_from_lists( g );
 
-        printf("Vertex %d - Color: %d, Distance: %d\n", vertex->airport_info.id, vertex->color, vertex->distance);
+   return g->out;
+}
 
-        printf("Airport Info:\n");
-        printf("ID: %d\n", vertex->airport_info.id);
-        printf("IATA Code: %s\n", vertex->airport_info.iata_code);
-        printf("Country: %s\n", vertex->airport_info.country);
-        printf("City: %s\n", vertex->airport_info.city);
-        printf("Name: %s\n", vertex->airport_info.name);
-        printf("UTC Time: %d\n", vertex->airport_info.utc_time);
+// devuelve el índice CSR de aristas de entrada. En un grafo no dirigido coincide con el de salida.
+static const CSR* in_edges( Graph* g )
+{
+   const CSR* out = out_edges( g );
 
-       if (vertex->neighbors)
-       {
-        printf("Códigos IATA de los vecinos: ");
-        for (List_Cursor_front(vertex->neighbors); !List_Cursor_end(vertex->neighbors);
-        List_Cursor_next(vertex->neighbors))
-             {
-          Data d = List_Cursor_get(vertex->neighbors);
-          int neighborIndex = d.index;
-          printf("%s(W:%.2f) ", g->vertices[neighborIndex].airport_info.iata_code, d.weight);
-          }
-    printf("\n");
-}
-    }
-    printf("\n");
+   if( g->type == eGraphType_UNDIRECTED || !out ) return out;
+
+   if( !g->in ) g->in = csr_transpose( out );
+
+   return g->in;
 }
 
-/**
- * @brief Obtiene el peso de la arista entre los vértices |start| y |finish| en el grafo.
- *
- * @param g      El grafo.
- * @param start  Vértice de salida (el dato)
- * @param finish Vértice de llegada (el dato)
- *
- * @return El peso de la arista si existe, -1.0 si la arista no existe.
- */
-double Graph_GetWeight( Graph* g, int start, int finish )
+// construye el grafo de componentes a partir de la asignación |comp| (con |count| componentes)
+static CSR* condensation( const CSR* out, const int comp[], int count )
 {
-   assert( g->len > 0 );
+   int n = out->n;
 
-   // Obtenemos los índices correspondientes:
-   int start_idx = find( g->vertices, g->size, start );
-   int finish_idx = find( g->vertices, g->size, finish );
+   // vértices agrupados por componente (ordenamiento por conteo)
+   int* first = (int*) calloc( count + 1, sizeof( int ) );
+   int* order = (int*) malloc( ( n > 0 ? n : 1 ) * sizeof( int ) );
+   int* mark = (int*) malloc( ( count > 0 ? count : 1 ) * sizeof( int ) );
+   Data* buf = (Data*) malloc( ( out->m > 0 ? out->m : 1 ) * sizeof( Data ) );
+   CSR* dag = NULL;
 
-   if( start_idx == -1 || finish_idx == -1 ) return -1.0;
-   // Uno o ambos vértices no existen
+   if( first && order && mark && buf )
+   {
+      for( int i = 0; i < n; ++i ) ++first[ comp[ i ] + 1 ];
+      for( int c = 0; c < count; ++c ) first[ c + 1 ] += first[ c ];
+      for( int i = 0; i < n; ++i ) order[ first[ comp[ i ] ]++ ] = i;
+      for( int c = count; c > 0; --c ) first[ c ] = first[ c - 1 ];
+      first[ 0 ] = 0;
 
-   Vertex* vertex = &g->vertices[ start_idx ];
-   if (vertex->neighbors) {
-      for (List_Cursor_front(vertex->neighbors);
-           !List_Cursor_end(vertex->neighbors);
-           List_Cursor_next(vertex->neighbors)) {
-         Data d = List_Cursor_get(vertex->neighbors);
-         if (d.index == finish_idx) {
-            return d.weight;
-         }
-      }
-   }
+      for( int c = 0; c < count; ++c ) mark[ c ] = -1;
 
-   return -1;
-}
+      // |mark[ d ]| guarda en qué posición de |buf| quedó la última arista hacia d; si es
+      // anterior al inicio de la componente actual, aún no hay arista c->d
+      int m = 0;
+      int* starts = (int*) malloc( ( count + 1 ) * sizeof( int ) );
+      if( starts )
+      {
+         for( int c = 0; c < count; ++c )
+         {
+            starts[ c ] = m;
+            for( int k = first[ c ]; k < first[ c + 1 ]; ++k )
+            {
+               int u = order[ k ];
+               for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+               {
+                  int d = comp[ out->adj[ e ].index ];
+                  float w = out->adj[ e ].weight;
 
+                  if( d == c ) continue;
 
-/**
- * @brief Crea un vértice a partir de los datos de un aeropuerto.
- *
- * @param g      El grafo.
- * @param airport La información del aeropuerto.
- */
-void Graph_AddVertex(Graph* g, Airport airport)
-{
-    assert(g->len < g->size);
+                  if( mark[ d ] < starts[ c ] )
+                  {
+                     mark[ d ] = m;
+                     buf[ m ].index = d;
+                     buf[ m ].weight = w;
+                     ++m;
+                  }
+                  else if( w < buf[ mark[ d ] ].weight ) buf[ mark[ d ] ].weight = w;
+               }
+            }
+         }
+         starts[ count ] = m;
 
-    Vertex* vertex = &g->vertices[g->len];
+         dag = csr_new( count, m );
+         if( dag )
+         {
+            memcpy( dag->start, starts, ( count + 1 ) * sizeof( int ) );
+            memcpy( dag->adj, buf, m * sizeof( Data ) );
+         }
 
-    // Inicializa los campos del vértice
-    vertex->data = g->len; // Puedes usar el índice como identificador
-    vertex->neighbors = NULL;
-    vertex->color = BLACK; // Inicializa el color a BLACK
-    vertex->distance = 0;  // Inicializa la distancia a 0
-    vertex->predecessor = -1; // Inicializa el predecesor a -1
-    vertex->airport_info = airport; // Copia la información del aeropuerto
+         free( starts );
+      }
+   }
 
-    ++g->len;
+   free( first );
+   free( order );
+   free( mark );
+   free( buf );
+
+   return dag;
 }
 
-int Graph_GetSize( Graph* g )
+// mapas de bits: un bit por vértice (o por arista)
+static inline bool bitmap_get( const uint64_t* bm, int i )
 {
-   return g->size;
+   return ( bm[ i >> 6 ] >> ( i & 63 ) ) & 1;
 }
 
-void Vertex_SetColor( Vertex* v, eGraphColors color )
+static inline void bitmap_set( uint64_t* bm, int i )
 {
-    v->color = color;
+   bm[ i >> 6 ] |= UINT64_C( 1 ) << ( i & 63 );
+}
+
+// montículo binario de mínimos; cada elemento es un par (índice, clave) que guardamos en un
+// Data, con la clave en el campo |weight|. No implementa decrease-key: se inserta de nuevo al
+// vértice con la clave menor y las entradas viejas se descartan al extraerlas.
+typedef struct
+{
+   Data* items;
+   int len;
+   int cap;
+} Heap;
+
+static void heap_clear( Heap* h )
+{
+   h->len = 0;
+}
+
+static void heap_free( Heap* h )
+{
+   free( h->items );
+   h->items = NULL;
+   h->len = h->cap = 0;
+}
+
+static bool heap_push( Heap* h, int index, float key )
+{
+   if( h->len == h->cap )
+   {
+      int cap = h->cap > 0 ? 2 * h->cap : 64;
+      Data* items = (Data*) realloc( h->items, cap * sizeof( Data ) );
+      if( !items ) return false;
+
+      h->items = items;
+      h->cap = cap;
+   }
+
+   int i = h->len++;
+   while( i > 0 && h->items[ ( i - 1 ) / 2 ].weight > key )
+   {
+      h->items[ i ] = h->items[ ( i - 1 ) / 2 ];
+      i = ( i - 1 ) / 2;
+   }
+   h->items[ i ].index = index;
+   h->items[ i ].weight = key;
+
+   return true;
+}
+
+static Data heap_pop( Heap* h )
+{
+   assert( h->len > 0 );
+
+   Data top = h->items[ 0 ];
+   Data last = h->items[ --h->len ];
+
+   int i = 0;
+   while( 2 * i + 1 < h->len )
+   {
+      int child = 2 * i + 1;
+      if( child + 1 < h->len && h->items[ child + 1 ].weight < h->items[ child ].weight ) ++child;
+      if( h->items[ child ].weight >= last.weight ) break;
+
+      h->items[ i ] = h->items[ child ];
+      i = child;
+   }
+   if( h->len > 0 ) h->items[ i ] = last;
+
+   return top;
+}
+
+static inline bool heap_is_empty( const Heap* h )
+{
+   return h->len == 0;
+}
+
+/**
+ * @brief Memoria de trabajo para las búsquedas de caminos más cortos (Dijkstra).
+ *
+ * Se crea una vez y se reutiliza entre búsquedas: en lugar de reiniciar los n elementos de
+ * cada arreglo, sólo se limpian los vértices que la búsqueda anterior tocó, así que el costo
+ * de cada búsqueda es proporcional a la región explorada.
+ */
+typedef struct Search
+{
+   float* dist;   ///< distancia desde el origen; INFINITY si no se ha alcanzado
+   int* pred;     ///< índice del predecesor en el árbol de caminos; -1 si no tiene
+   int* touched;  ///< vértices cuya distancia dejó de ser INFINITY
+   int n_touched;
+   int n;         ///< número de vértices para los que se creó
+   Heap heap;
+} Search;
+
+static Search* search_new( int n )
+{
+   Search* s = (Search*) malloc( sizeof( Search ) );
+   if( s )
+   {
+      s->n = n;
+      s->n_touched = 0;
+      s->dist = (float*) malloc( ( n > 0 ? n : 1 ) * sizeof( float ) );
+      s->pred = (int*) malloc( ( n > 0 ? n : 1 ) * sizeof( int ) );
+      s->touched = (int*) malloc( ( n > 0 ? n : 1 ) * sizeof( int ) );
+      s->heap.items = NULL;
+      s->heap.len = s->heap.cap = 0;
+
+      if( !s->dist || !s->pred || !s->touched )
+      {
+         free( s->dist );
+         free( s->pred );
+         free( s->touched );
+         free( s );
+         return NULL;
+      }
+
+      for( int i = 0; i < n; ++i )
+      {
+         s->dist[ i ] = INFINITY;
+         s->pred[ i ] = -1;
+      }
+   }
+
+   return s;
+}
+
+static void search_delete( Search** p_search )
+{
+   if( *p_search )
+   {
+      free( (*p_search)->dist );
+      free( (*p_search)->pred );
+      free( (*p_search)->touched );
+      heap_free( &(*p_search)->heap );
+      free( *p_search );
+      *p_search = NULL;
+   }
+}
+
+// limpia únicamente a los vértices tocados por la búsqueda anterior
+static void search_reset( Search* s )
+{
+   for( int k = 0; k < s->n_touched; ++k )
+   {
+      s->dist[ s->touched[ k ] ] = INFINITY;
+      s->pred[ s->touched[ k ] ] = -1;
+   }
+   s->n_touched = 0;
+   heap_clear( &s->heap );
+}
+
+static inline void search_relax( Search* s, int v, float d, int pred )
+{
+   if( s->dist[ v ] == INFINITY ) s->touched[ s->n_touched++ ] = v;
+   s->dist[ v ] = d;
+   s->pred[ v ] = pred;
+}
+
+// Dijkstra desde |src| sobre |out|. Se detiene al asentar a |target| (si no es -1) o al
+// rebasar la distancia |limit|. Los vértices marcados en |banned_v| y las aristas (posiciones
+// en |out|) marcadas en |banned_e| se ignoran; ambos pueden ser NULL.
+// Si |potential| no es NULL la búsqueda es A*: potential[ v ] es una cota inferior (consistente)
+// de la distancia de v a |target|, e INFINITY si desde v no se puede llegar; |limit| se compara
+// entonces contra la longitud estimada del camino completo.
+// ret: false si no hubo memoria.
+static bool search_run( Search* s, const CSR* out, int src, int target, float limit,
+                        const uint64_t* banned_v, const uint64_t* banned_e,
+                        const float* potential )
+{
+   search_reset( s );
+
+   float h = potential ? potential[ src ] : 0.0f;
+   if( h == INFINITY ) return true;
+
+   search_relax( s, src, 0.0f, -1 );
+   if( !heap_push( &s->heap, src, h ) ) return false;
+
+   while( !heap_is_empty( &s->heap ) )
+   {
+      Data top = heap_pop( &s->heap );
+      int u = top.index;
+      float du = s->dist[ u ];
+
+      if( top.weight > du + ( potential ? potential[ u ] : 0.0f ) ) continue;
+      // entrada vieja: |u| ya se asentó con una distancia menor
+
+      if( top.weight > limit || u == target ) break;
+
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         if( banned_e && bitmap_get( banned_e, e ) ) continue;
+         if( banned_v && bitmap_get( banned_v, v ) ) continue;
+
+         float d = du + out->adj[ e ].weight;
+         if( d < s->dist[ v ] )
+         {
+            float hv = potential ? potential[ v ] : 0.0f;
+            if( hv == INFINITY ) continue;
+
+            search_relax( s, v, d, u );
+            if( !heap_push( &s->heap, v, d + hv ) ) return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+// devuelve la búsqueda del grafo, creándola si hace falta
+static Search* graph_search( Graph* g )
+{
+   if( g->search && g->search->n != g->len ) search_delete( &g->search );
+   if( !g->search ) g->search = search_new( g->len );
+
+   return g->search;
+}
+
+// copia en |path| el camino hacia |target| que dejó la última búsqueda
+static bool search_path( const Search* s, int target, Path* path )
+{
+   int len = 0;
+   for( int v = target; v != -1; v = s->pred[ v ] ) ++len;
+
+   path->vertices = (int*) malloc( len * sizeof( int ) );
+   if( !path->vertices ) return false;
+
+   path->len = len;
+   path->cost = s->dist[ target ];
+   for( int v = target, k = len - 1; v != -1; v = s->pred[ v ], --k ) path->vertices[ k ] = v;
+
+   return true;
+}
+
+// posición en |out| de la arista u->v; -1 si no existe
+static int csr_find_edge( const CSR* out, int u, int v )
+{
+   for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+   {
+      if( out->adj[ e ].index == v ) return e;
+   }
+   return -1;
+}
+
+// cambia el peso de la arista u->v en la lista de |u| y en los índices CSR que existan;
+// false si la arista no existe
+static bool set_weight( Graph* g, int u, int v, float weight )
+{
+   Node* it = g->vertices[ u ].neighbors ? g->vertices[ u ].neighbors->first : NULL;
+   while( it && it->data.index != v ) it = it->next;
+   if( !it ) return false;
+
+   it->data.weight = weight;
+
+   int e;
+   if( g->out && ( e = csr_find_edge( g->out, u, v ) ) != -1 ) g->out->adj[ e ].weight = weight;
+   if( g->in && g->in != g->out && ( e = csr_find_edge( g->in, v, u ) ) != -1 ) g->in->adj[ e ].weight = weight;
+
+   return true;
+}
+
+// descarta los índices CSR; se debe llamar siempre que cambien las listas de vecinos
+static void invalidate( Graph* g )
+{
+   csr_delete( &g->out );
+   csr_delete( &g->in );
+   ++g->version;
+}
+
+
+
+//----------------------------------------------------------------------
+//                     Funciones públicas
+//----------------------------------------------------------------------
+
+
+/**
+ * @brief Crea un nuevo grafo.
+ *
+ * @param size Número de vértices que tendrá el grafo. Este valor no se puede
+ * cambiar luego de haberlo creado.
+ *
+ * @return Un nuevo grafo.
+ *
+ * @pre El número de elementos es mayor que 0.
+ */
+Graph* Graph_New( int size, eGraphType type )
+{
+   assert( size > 0 );
+
+   Graph* g = (Graph*) malloc( sizeof( Graph ) );
+   if( g )
+   {
+      g->size = size;
+      g->len = 0;
+      g->type = type;
+      g->out = NULL;
+      g->in = NULL;
+      g->search = NULL;
+      g->version = 0;
+      g->strings.arena = NULL;
+      g->strings.slots = NULL;
+
+      int slots = 16;
+      while( slots < 2 * size ) slots *= 2;
+      g->keys = (int*) calloc( slots, sizeof( int ) );
+      g->keys_mask = slots - 1;
+      // si no hubo memoria para la tabla, las búsquedas por llave serán lineales
+
+      g->iata = (int*) calloc( IATA_CODES, sizeof( int ) );
+
+      g->vertices = (Vertex*) calloc( size, sizeof( Vertex ) );
+
+      if( !g->vertices || !g->iata || !pool_init( &g->strings ) )
+      {
+         free( g->vertices );
+         free( g->iata );
+         pool_free( &g->strings );
+         free( g->keys );
+         free( g );
+         g = NULL;
+      }
+   }
+
+   return g;
+   // el cliente es responsable de verificar que el grafo se haya creado correctamente
+}
+
+/**
+ * @brief Devuelve la cadena con identificador |handle| del almacén de cadenas del grafo (por
+ * ejemplo, el país, la ciudad o el nombre de un aeropuerto).
+ *
+ * @param g      El grafo.
+ * @param handle El identificador de la cadena.
+ *
+ * @return La cadena. El apuntador deja de ser válido si se agregan más vértices al grafo.
+ */
+const char* Graph_GetString( const Graph* g, uint32_t handle )
+{
+   assert( handle < g->strings.len || handle == 0 );
+
+   return g->strings.arena ? &g->strings.arena[ handle ] : "";
+}
+
+/**
+ * @brief Busca un aeropuerto por su código IATA.
+ *
+ * Los códigos de tres letras mayúsculas se buscan en una tabla con una casilla por cada
+ * código posible, así que la búsqueda es una sola lectura; cualquier otro código se busca
+ * recorriendo los vértices.
+ *
+ * @param g    El grafo.
+ * @param code El código IATA, por ejemplo "MEX".
+ *
+ * @return El índice del vértice, o -1 si no existe.
+ */
+int Graph_FindByIATA( const Graph* g, const char* code )
+{
+   int number = code[ 0 ] && code[ 1 ] && code[ 2 ] ? iata_number( code ) : -1;
+
+   if( number != -1 ) return g->iata[ number ] - 1;
+
+   for( int i = 0; i < g->len; ++i )
+   {
+      if( strcmp( g->vertices[ i ].airport_info.iata_code, code ) == 0 ) return i;
+   }
+   return -1;
+}
+
+/**
+ * @brief Busca un aeropuerto por su id (la llave del vértice).
+ *
+ * @param g   El grafo.
+ * @param key El id del aeropuerto.
+ *
+ * @return El índice del vértice, o -1 si no existe.
+ */
+int Graph_FindByKey( const Graph* g, int key )
+{
+   return find_key( g, key );
+}
+
+/**
+ * @brief Libera un índice CSR devuelto por alguna función del grafo.
+ *
+ * @param p_csr Referencia al índice; queda en NULL.
+ */
+void CSR_Delete( CSR** p_csr )
+{
+   csr_delete( p_csr );
+}
+
+void Graph_Delete( Graph** g )
+{
+   assert( *g );
+
+   Graph* graph = *g;
+   // para simplificar la notación 
+
+   for( int i = 0; i < graph->size; ++i )
+   {
+      Vertex* vertex = &graph->vertices[ i ];
+      // para simplificar la notación. 
+      // La variable |vertex| sólo existe dentro de este for.
+
+      if( vertex->neighbors )
+      {
+         List_Delete( &(vertex->neighbors) );
+      }
+   }
+
+   invalidate( graph );
+   search_delete( &graph->search );
+   free( graph->keys );
+   free( graph->iata );
+   pool_free( &graph->strings );
+
+   free( graph->vertices );
+   free( graph );
+   *g = NULL;
+}
+
+void Graph_Print(Graph* g, int depth)
+{
+    for (int i = 0; i < g->len; ++i)
+    {
+        Vertex* vertex = &g->vertices[i];
+
+        printf("Vertex %d - Color: %d, Distance: %d\n", vertex->airport_info.id, vertex->color, vertex->distance);
+
+        printf("Airport Info:\n");
+        printf("ID: %d\n", vertex->airport_info.id);
+        printf("IATA Code: %s\n", vertex->airport_info.iata_code);
+        printf("Country: %s\n", Graph_GetString(g, vertex->airport_info.country));
+        printf("City: %s\n", Graph_GetString(g, vertex->airport_info.city));
+        printf("Name: %s\n", Graph_GetString(g, vertex->airport_info.name));
+        printf("UTC Time: %d\n", vertex->airport_info.utc_time);
+
+       if (vertex->neighbors)
+       {
+        printf("Códigos IATA de los vecinos: ");
+        for (List_Cursor_front(vertex->neighbors); !List_Cursor_end(vertex->neighbors);
+        List_Cursor_next(vertex->neighbors))
+             {
+          Data d = List_Cursor_get(vertex->neighbors);
+          int neighborIndex = d.index;
+          printf("%s(W:%.2f) ", g->vertices[neighborIndex].airport_info.iata_code, d.weight);
+          }
+    printf("\n");
+}
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Obtiene el peso de la arista entre los vértices |start| y |finish| en el grafo.
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vértice de llegada (el dato)
+ *
+ * @return El peso de la arista si existe, -1.0 si la arista no existe.
+ */
+double Graph_GetWeight( Graph* g, int start, int finish )
+{
+   assert( g->len > 0 );
+
+   // Obtenemos los índices correspondientes:
+   int start_idx = find_key( g, start );
+   int finish_idx = find_key( g, finish );
+
+   if( start_idx == -1 || finish_idx == -1 ) return -1.0;
+   // Uno o ambos vértices no existen
+
+   Vertex* vertex = &g->vertices[ start_idx ];
+   if (vertex->neighbors) {
+      for (List_Cursor_front(vertex->neighbors);
+           !List_Cursor_end(vertex->neighbors);
+           List_Cursor_next(vertex->neighbors)) {
+         Data d = List_Cursor_get(vertex->neighbors);
+         if (d.index == finish_idx) {
+            return d.weight;
+         }
+      }
+   }
+
+   return -1;
+}
+
+
+/**
+ * @brief Crea un vértice a partir de los datos de un aeropuerto.
+ *
+ * El país, la ciudad y el nombre se copian al almacén de cadenas del grafo, así que el cliente
+ * puede reutilizar o liberar |airport| después de la llamada.
+ *
+ * @param g      El grafo.
+ * @param airport La información del aeropuerto.
+ *
+ * @return false si no hubo memoria para copiar las cadenas; en ese caso no se agrega el vértice.
+ */
+bool Graph_AddVertex(Graph* g, const Airport* airport)
+{
+    assert(g->len < g->size);
+
+    uint32_t country, city, name;
+    if (!pool_intern(&g->strings, airport->country, &country) ||
+        !pool_intern(&g->strings, airport->city, &city) ||
+        !pool_intern(&g->strings, airport->name, &name))
+    {
+        return false;
+    }
+
+    Vertex* vertex = &g->vertices[g->len];
+
+    // Inicializa los campos del vértice
+    vertex->data = airport->id; // El id del aeropuerto es la llave de búsqueda
+    vertex->neighbors = NULL;
+    vertex->color = BLACK; // Inicializa el color a BLACK
+    vertex->distance = 0;  // Inicializa la distancia a 0
+    vertex->predecessor = -1; // Inicializa el predecesor a -1
+    vertex->in_cursor = vertex->in_end = NULL;
+
+    // Copia la información del aeropuerto
+    AirportInfo* info = &vertex->airport_info;
+    info->id = airport->id;
+    memcpy(info->iata_code, airport->iata_code, sizeof(info->iata_code));
+    info->country = country;
+    info->city = city;
+    info->name = name;
+    info->utc_time = airport->utc_time;
+    info->latitude = airport->latitude;
+    info->longitude = airport->longitude;
+
+    int code = iata_number(info->iata_code);
+    if (code != -1 && g->iata[code] == 0) g->iata[code] = g->len + 1;
+
+    key_index_add(g, g->len);
+    ++g->len;
+
+    invalidate(g);
+
+    return true;
+}
+
+int Graph_GetSize( Graph* g )
+{
+   return g->size;
+}
+
+void Vertex_SetColor( Vertex* v, eGraphColors color )
+{
+    v->color = color;
 }
 
 eGraphColors Vertex_GetColor( Vertex* v )
 {
-    return v->color;
+    return v->color;
+}
+
+void Vertex_SetDistance( Vertex* v, int distance )
+{
+    v->distance = distance;
+}
+
+int Vertex_GetDistance( Vertex* v )
+{
+    return v->distance;
+}
+
+void Vertex_SetPredecessor( Vertex* v, int predecessor_idx )
+{
+    v->predecessor = predecessor_idx;
+}
+
+int Vertex_GetPredecessor( Vertex* v )
+{
+    return v->predecessor;
+}
+
+
+
+/**
+ * @brief Inserta una relación de adyacencia del vértice |start| hacia el vértice |finish|.
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vertice de llegada (el dato)
+ *
+ * @return false si uno o ambos vértices no existen; true si la relación se creó con éxito.
+ *
+ * @pre El grafo no puede estar vacío.
+ */
+bool Graph_AddEdge( Graph* g, int start, int finish )
+{
+   assert( g->len > 0 );
+
+   // obtenemos los índices correspondientes:
+   int start_idx = find_key( g, start );
+   int finish_idx = find_key( g, finish );
+
+   DBG_PRINT( "AddEdge(): from:%d (with index:%d), to:%d (with index:%d)\n", start, start_idx, finish, finish_idx );
+
+   if( start_idx == -1 || finish_idx == -1 ) return false;
+   // uno o ambos vértices no existen
+
+   insert( &g->vertices[ start_idx ], finish_idx, 0.0 );
+   // insertamos la arista start-finish
+
+   invalidate( g );
+
+   if( g->type == eGraphType_UNDIRECTED ) insert( &g->vertices[ finish_idx ], start_idx, 0.0 );
+   // si el grafo no es dirigido, entonces insertamos la arista finish-start
+
+   return true;
+}
+
+
+int Graph_GetLen( Graph* g )
+{
+   return g->len;
+}
+
+
+/**
+ * @brief Devuelve la información asociada al vértice indicado.
+ *
+ * @param g          Un grafo.
+ * @param vertex_idx El índice del vértice del cual queremos conocer su información.
+ *
+ * @return La información asociada al vértice vertex_idx.
+ */
+Item Graph_GetDataByIndex( const Graph* g, int vertex_idx )
+{
+   assert( 0 <= vertex_idx && vertex_idx < g->len );
+
+   return g->vertices[ vertex_idx ].data;
+}
+
+/**
+ * @brief Devuelve una referencia al vértice indicado.
+ *
+ * Esta función puede ser utilizada con las operaciones @see Vertex_Start(), @see Vertex_End(), @see Vertex_Next().
+ *
+ * @param g          Un grafo
+ * @param vertex_idx El índice del vértice del cual queremos devolver la referencia.
+ *
+ * @return La referencia al vértice vertex_idx.
+ */
+Vertex* Graph_GetVertexByIndex( const Graph* g, int vertex_idx )
+{
+   assert( 0 <= vertex_idx && vertex_idx < g->len );
+
+   return &(g->vertices[ vertex_idx ] );
+}
+
+/**
+ * @brief Construye de una vez los índices compactos de aristas de salida y de entrada.
+ *
+ * Los algoritmos los construyen bajo demanda, pero conviene llamar a esta función luego de
+ * terminar de insertar aristas y antes de consultar al grafo desde varios hilos, ya que la
+ * construcción bajo demanda no es segura entre hilos.
+ *
+ * @param g El grafo.
+ *
+ * @return false si no hubo memoria; true en caso contrario.
+ */
+bool Graph_Freeze( Graph* g )
+{
+   return out_edges( g ) && in_edges( g );
+}
+
+/**
+ * @brief Hace que el cursor de aristas de entrada del vértice |v| apunte a su primera arista
+ * de entrada. Se debe llamar siempre que se vaya a iniciar un recorrido de dichas aristas.
+ *
+ * Las aristas de entrada se toman del índice transpuesto del grafo (que se construye si hace
+ * falta), así que recorrerlas cuesta lo mismo que el número de aristas que llegan a |v|. En
+ * un grafo no dirigido coinciden con la lista de vecinos.
+ *
+ * @param g El grafo al que pertenece |v|.
+ * @param v El vértice de trabajo.
+ *
+ * @post No se deben insertar vértices ni aristas mientras dure el recorrido.
+ *
+ * Ejemplo
+ * @code
+   Vertex* v = Graph_GetVertexByIndex( grafo, 0 );
+   for( Vertex_InStart( grafo, v ); !Vertex_InEnd( v ); Vertex_InNext( v ) )
+   {
+      int from = Vertex_GetInNeighborIndex( v ).index;
+      // ...
+   }
+   @endcode
+ */
+void Vertex_InStart( Graph* g, Vertex* v )
+{
+   assert( v );
+
+   const CSR* in = in_edges( g );
+   int idx = (int) ( v - g->vertices );
+
+   if( in )
+   {
+      v->in_cursor = &in->adj[ in->start[ idx ] ];
+      v->in_end = &in->adj[ in->start[ idx + 1 ] ];
+   }
+   else v->in_cursor = v->in_end = NULL;
+}
+
+/**
+ * @brief Mueve el cursor de aristas de entrada una posición adelante.
+ *
+ * @param v El vértice de trabajo.
+ *
+ * @pre El cursor apunta a una arista válida.
+ */
+void Vertex_InNext( Vertex* v )
+{
+   ++v->in_cursor;
+}
+
+/**
+ * @brief Indica si se alcanzó el final de las aristas de entrada.
+ *
+ * @param v El vértice de trabajo.
+ *
+ * @return true si se alcanzó el final; false en cualquier otro caso.
+ */
+bool Vertex_InEnd( const Vertex* v )
+{
+   return v->in_cursor == v->in_end;
+}
+
+/**
+ * @brief Devuelve el índice del vértice del que sale la arista de entrada a la que apunta el
+ * cursor, junto con el peso de esa arista.
+ *
+ * @param v El vértice de trabajo.
+ *
+ * @pre El cursor debe apuntar a una arista válida.
+ */
+Data Vertex_GetInNeighborIndex( const Vertex* v )
+{
+   assert( v->in_cursor != v->in_end );
+
+   return *v->in_cursor;
+}
+
+/**
+ * @brief Devuelve el número de aristas que llegan a un vértice.
+ *
+ * @param g     El grafo.
+ * @param key   El vértice (el dato)
+ *
+ * @return El número de aristas de entrada, o -1 si el vértice no existe o no hubo memoria.
+ */
+int Graph_GetInDegree( Graph* g, int key )
+{
+   int idx = find_key( g, key );
+   const CSR* in = idx != -1 ? in_edges( g ) : NULL;
+
+   return in ? csr_degree( in, idx ) : -1;
+}
+
+/**
+ * @brief Cambia el peso de la arista del vértice |start| hacia el vértice |finish|. Si el
+ * grafo no es dirigido también cambia el de la arista de regreso.
+ *
+ * Los índices CSR se actualizan en su lugar, así que no hay que reconstruirlos.
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vertice de llegada (el dato)
+ * @param weight El nuevo peso.
+ *
+ * @return false si uno o ambos vértices no existen o si no hay arista entre ellos; true en caso
+ * contrario.
+ */
+bool Graph_SetWeight( Graph* g, int start, int finish, float weight )
+{
+   int start_idx = find_key( g, start );
+   int finish_idx = find_key( g, finish );
+
+   if( start_idx == -1 || finish_idx == -1 ) return false;
+
+   if( !set_weight( g, start_idx, finish_idx, weight ) ) return false;
+
+   if( g->type == eGraphType_UNDIRECTED ) set_weight( g, finish_idx, start_idx, weight );
+
+   ++g->version;
+
+   return true;
+}
+
+/**
+ * @brief Inserta una relación de adyacencia del vértice |start| hacia el vértice |finish| con un peso dado.
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vertice de llegada (el dato)
+ * @param weight Peso de la arista.
+ *
+ * @return false si uno o ambos vértices no existen; true si la relación se creó con éxito.
+ *
+ * @pre El grafo no puede estar vacío.
+ */
+bool Graph_AddWeightedEdge( Graph* g, int start, int finish, float weight )
+{
+   assert( g->len > 0 );
+
+   // obtenemos los índices correspondientes:
+   int start_idx = find_key( g, start );
+   int finish_idx = find_key( g, finish );
+
+   DBG_PRINT( "AddWeightedEdge(): from:%d (with index:%d), to:%d (with index:%d), weight:%f\n", start, start_idx, finish, finish_idx, weight );
+
+   if( start_idx == -1 || finish_idx == -1 ) return false;
+   // uno o ambos vértices no existen
+
+   insert( &g->vertices[ start_idx ], finish_idx, weight );
+   // insertamos la arista start-finish con el peso especificado
+
+   invalidate( g );
+
+   if( g->type == eGraphType_UNDIRECTED ) insert( &g->vertices[ finish_idx ], start_idx, weight );
+   // si el grafo no es dirigido, entonces insertamos la arista finish-start con el peso especificado
+
+   return true;
+}
+
+/**
+ * @brief Indica si un vértice tiene una relación de adyacencia con otro en un grafo no dirigido.
+ *
+ * @param g     El grafo.
+ * @param dest  Vértice de llegada (el dato)
+ * @param src   Vértice de salida (el dato)
+ *
+ * @return true si dest es vecino de src en un grafo no dirigido, false en cualquier otro caso.
+ */
+bool Graph_IsNeighborOf( Graph* g, int dest, int src )
+{
+   assert( g->len > 0 );
+
+   // Obtenemos los índices correspondientes:
+   int src_idx = find_key( g, src );
+   int dest_idx = find_key( g, dest );
+
+   if (src_idx == -1 || dest_idx == -1) {
+      return false; // Uno o ambos vértices no existen
+   }
+
+   // Verificamos si src tiene una relación de adyacencia con dest
+   Vertex* src_vertex = &g->vertices[src_idx];
+   if (src_vertex->neighbors) {
+      for (List_Cursor_front(src_vertex->neighbors);
+           !List_Cursor_end(src_vertex->neighbors);
+           List_Cursor_next(src_vertex->neighbors)) {
+         Data d = List_Cursor_get(src_vertex->neighbors);
+         if (d.index == dest_idx) {
+            return true; // dest es vecino de src
+         }
+      }
+   }
+
+   return false; // No se encontró una relación de adyacencia entre src y dest
+}
+
+//----------------------------------------------------------------------
+//                           Recorridos: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Recorre el grafo a lo ancho (BFS) a partir del vértice |start|.
+ *
+ * Al terminar, cada vértice alcanzado queda en color WHITE con su distancia (en número de
+ * aristas) al vértice de inicio y el índice de su predecesor en el árbol BFS. Los vértices no
+ * alcanzados quedan en color BLACK, con distancia y predecesor iguales a -1.
+ *
+ * @param g     El grafo.
+ * @param start Vértice de inicio (el dato)
+ *
+ * @return false si el vértice de inicio no existe o no hubo memoria; true en caso contrario.
+ */
+bool Graph_BFS( Graph* g, int start )
+{
+   assert( g->len > 0 );
+
+   int start_idx = find_key( g, start );
+   if( start_idx == -1 ) return false;
+
+   int* queue = (int*) malloc( g->len * sizeof( int ) );
+   if( !queue ) return false;
+
+   for( int i = 0; i < g->len; ++i )
+   {
+      Vertex_SetColor( &g->vertices[ i ], BLACK );
+      Vertex_SetDistance( &g->vertices[ i ], -1 );
+      Vertex_SetPredecessor( &g->vertices[ i ], -1 );
+   }
+
+   int head = 0;
+   int tail = 0;
+
+   Vertex_SetColor( &g->vertices[ start_idx ], GRAY );
+   Vertex_SetDistance( &g->vertices[ start_idx ], 0 );
+   queue[ tail++ ] = start_idx;
+
+   while( head < tail )
+   {
+      int u = queue[ head++ ];
+      Vertex* v = &g->vertices[ u ];
+
+      if( v->neighbors )
+      {
+         for( Vertex_Start( v ); !Vertex_End( v ); Vertex_Next( v ) )
+         {
+            int w = Vertex_GetNeighborIndex( v ).index;
+
+            if( Vertex_GetColor( &g->vertices[ w ] ) == BLACK )
+            {
+               Vertex_SetColor( &g->vertices[ w ], GRAY );
+               Vertex_SetDistance( &g->vertices[ w ], Vertex_GetDistance( v ) + 1 );
+               Vertex_SetPredecessor( &g->vertices[ w ], u );
+               queue[ tail++ ] = w;
+            }
+         }
+      }
+
+      Vertex_SetColor( v, WHITE );
+   }
+
+   free( queue );
+   return true;
+}
+
+
+// Parámetros de la heurística de Beamer para cambiar de dirección en el BFS híbrido:
+// se pasa a "de abajo hacia arriba" cuando las aristas de la frontera superan 1/ALPHA de las
+// aristas aún sin explorar, y se regresa cuando la frontera baja de 1/BETA de los vértices.
+#ifndef BFS_ALPHA
+#define BFS_ALPHA 14
+#endif
+
+#ifndef BFS_BETA
+#define BFS_BETA 24
+#endif
+
+// paso "de arriba hacia abajo": expande la frontera queue[ *head, *tail ) por sus aristas de
+// salida. Devuelve la suma de los grados de salida de la nueva frontera.
+static long bfs_top_down_step( const CSR* out, int* dist, int* pred, int* queue,
+                               int* head, int* tail, int level )
+{
+   long frontier_edges = 0;
+   int end = *tail;
+
+   for( int q = *head; q < end; ++q )
+   {
+      int u = queue[ q ];
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         if( dist[ v ] == -1 )
+         {
+            dist[ v ] = level + 1;
+            pred[ v ] = u;
+            queue[ (*tail)++ ] = v;
+            frontier_edges += csr_degree( out, v );
+         }
+      }
+   }
+
+   *head = end;
+   return frontier_edges;
+}
+
+// paso "de abajo hacia arriba": cada vértice no visitado busca entre sus aristas de entrada
+// algún padre en la frontera |front| y se detiene en el primero que encuentra. Devuelve el
+// tamaño de la nueva frontera, que queda en |next|.
+static int bfs_bottom_up_step( const CSR* out, const CSR* in, int* dist, int* pred,
+                               const uint64_t* front, uint64_t* next, int level,
+                               long* edges_to_check )
+{
+   int awake = 0;
+   int words = ( in->n + 63 ) / 64;
+
+   memset( next, 0, words * sizeof( uint64_t ) );
+
+   for( int v = 0; v < in->n; ++v )
+   {
+      if( dist[ v ] != -1 ) continue;
+
+      for( int e = in->start[ v ]; e < in->start[ v + 1 ]; ++e )
+      {
+         int u = in->adj[ e ].index;
+         if( bitmap_get( front, u ) )
+         {
+            dist[ v ] = level + 1;
+            pred[ v ] = u;
+            bitmap_set( next, v );
+            *edges_to_check -= csr_degree( out, v );
+            ++awake;
+            break;
+         }
+      }
+   }
+
+   return awake;
+}
+
+/**
+ * @brief Recorrido BFS que alterna entre pasos "de arriba hacia abajo" y "de abajo hacia
+ * arriba" (Beamer et al., direction-optimizing BFS).
+ *
+ * Cuando la frontera es grande (algo común en grafos con concentradores, como las redes de
+ * aeropuertos) es más barato que cada vértice no visitado busque a su padre en la frontera
+ * que expandir todas las aristas de la frontera. En los grafos dirigidos se usa el índice de
+ * aristas de entrada. Deja los resultados en los mismos campos que Graph_BFS().
+ *
+ * @param g     El grafo.
+ * @param start Vértice de inicio (el dato)
+ *
+ * @return false si el vértice de inicio no existe o no hubo memoria; true en caso contrario.
+ */
+bool Graph_BFS_DirectionOptimizing( Graph* g, int start )
+{
+   assert( g->len > 0 );
+
+   int start_idx = find_key( g, start );
+   if( start_idx == -1 ) return false;
+
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+   if( !out || !in ) return false;
+
+   int n = g->len;
+   int words = ( n + 63 ) / 64;
+
+   int* dist = (int*) malloc( n * sizeof( int ) );
+   int* pred = (int*) malloc( n * sizeof( int ) );
+   int* queue = (int*) malloc( n * sizeof( int ) );
+   uint64_t* front = (uint64_t*) calloc( words, sizeof( uint64_t ) );
+   uint64_t* next = (uint64_t*) calloc( words, sizeof( uint64_t ) );
+
+   bool ok = dist && pred && queue && front && next;
+
+   if( ok )
+   {
+      for( int i = 0; i < n; ++i ) dist[ i ] = pred[ i ] = -1;
+
+      int head = 0;
+      int tail = 0;
+      int level = 0;
+
+      dist[ start_idx ] = 0;
+      queue[ tail++ ] = start_idx;
+
+      long frontier_edges = csr_degree( out, start_idx );
+      long edges_to_check = out->m - frontier_edges;
+
+      while( head < tail )
+      {
+         if( frontier_edges > edges_to_check / BFS_ALPHA )
+         {
+            memset( front, 0, words * sizeof( uint64_t ) );
+            for( int q = head; q < tail; ++q ) bitmap_set( front, queue[ q ] );
+
+            int awake = tail - head;
+            int old_awake;
+            do
+            {
+               old_awake = awake;
+               awake = bfs_bottom_up_step( out, in, dist, pred, front, next, level, &edges_to_check );
+               ++level;
+
+               uint64_t* tmp = front;
+               front = next;
+               next = tmp;
+            } while( awake > 0 && ( awake >= old_awake || awake > n / BFS_BETA ) );
+
+            // de regreso a la frontera como cola
+            head = tail = 0;
+            frontier_edges = 0;
+            for( int v = 0; v < n; ++v )
+            {
+               if( bitmap_get( front, v ) )
+               {
+                  queue[ tail++ ] = v;
+                  frontier_edges += csr_degree( out, v );
+               }
+            }
+         }
+         else
+         {
+            edges_to_check -= frontier_edges;
+            frontier_edges = bfs_top_down_step( out, dist, pred, queue, &head, &tail, level );
+            ++level;
+         }
+      }
+
+      for( int i = 0; i < n; ++i )
+      {
+         Vertex_SetColor( &g->vertices[ i ], dist[ i ] == -1 ? BLACK : WHITE );
+         Vertex_SetDistance( &g->vertices[ i ], dist[ i ] );
+         Vertex_SetPredecessor( &g->vertices[ i ], pred[ i ] );
+      }
+   }
+
+   free( dist );
+   free( pred );
+   free( queue );
+   free( front );
+   free( next );
+
+   return ok;
+}
+
+// tamaño del bloque de vértices de la frontera que cada hilo toma a la vez, y del búfer
+// local donde cada hilo acumula a los vértices que descubre antes de publicarlos
+#ifndef BFS_CHUNK
+#define BFS_CHUNK 64
+#endif
+
+#ifndef BFS_LOCAL_BUF
+#define BFS_LOCAL_BUF 256
+#endif
+
+/**
+ * @brief Recorrido BFS paralelo, sincronizado por niveles.
+ *
+ * Los hilos se reparten dinámicamente bloques de la frontera (quien termina su bloque toma
+ * el siguiente, así que la carga se balancea sola aunque haya vértices con grado muy alto).
+ * Cada vértice se reclama con una operación atómica compare-and-swap sobre un arreglo de
+ * predecesores propio del recorrido, de modo que no se comparte el campo color de los
+ * vértices entre hilos. Deja los resultados en los mismos campos que Graph_BFS(), aunque el
+ * predecesor elegido puede variar de una ejecución a otra cuando hay empates.
+ *
+ * @param g     El grafo.
+ * @param start Vértice de inicio (el dato)
+ *
+ * @return false si el vértice de inicio no existe o no hubo memoria; true en caso contrario.
+ */
+bool Graph_BFS_Parallel( Graph* g, int start )
+{
+   assert( g->len > 0 );
+
+   int start_idx = find_key( g, start );
+   if( start_idx == -1 ) return false;
+
+   const CSR* out = out_edges( g );
+   if( !out ) return false;
+
+   int n = g->len;
+
+   int* dist = (int*) malloc( n * sizeof( int ) );
+   int* pred = (int*) malloc( n * sizeof( int ) );
+   int* cur = (int*) malloc( n * sizeof( int ) );
+   int* next = (int*) malloc( n * sizeof( int ) );
+
+   bool ok = dist && pred && cur && next;
+
+   if( ok )
+   {
+      #pragma omp parallel for schedule( static )
+      for( int i = 0; i < n; ++i ) dist[ i ] = pred[ i ] = -1;
+
+      dist[ start_idx ] = 0;
+      pred[ start_idx ] = start_idx;
+      // el inicio es su propio padre durante el recorrido para que nadie lo reclame
+
+      cur[ 0 ] = start_idx;
+      int cur_len = 1;
+      int level = 0;
+
+      while( cur_len > 0 )
+      {
+         int next_len = 0;
+
+         #pragma omp parallel
+         {
+            int local[ BFS_LOCAL_BUF ];
+            int local_len = 0;
+
+            #pragma omp for schedule( dynamic, BFS_CHUNK )
+            for( int q = 0; q < cur_len; ++q )
+            {
+               int u = cur[ q ];
+               for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+               {
+                  int v = out->adj[ e ].index;
+                  int expected = -1;
+
+                  if( __atomic_load_n( &pred[ v ], __ATOMIC_RELAXED ) == -1 &&
+                      __atomic_compare_exchange_n( &pred[ v ], &expected, u, false,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+                  {
+                     dist[ v ] = level + 1;
+                     local[ local_len++ ] = v;
+
+                     if( local_len == BFS_LOCAL_BUF )
+                     {
+                        int pos = __atomic_fetch_add( &next_len, local_len, __ATOMIC_RELAXED );
+                        memcpy( &next[ pos ], local, local_len * sizeof( int ) );
+                        local_len = 0;
+                     }
+                  }
+               }
+            }
+
+            if( local_len > 0 )
+            {
+               int pos = __atomic_fetch_add( &next_len, local_len, __ATOMIC_RELAXED );
+               memcpy( &next[ pos ], local, local_len * sizeof( int ) );
+            }
+         }
+
+         int* tmp = cur;
+         cur = next;
+         next = tmp;
+         cur_len = next_len;
+         ++level;
+      }
+
+      pred[ start_idx ] = -1;
+
+      #pragma omp parallel for schedule( static )
+      for( int i = 0; i < n; ++i )
+      {
+         Vertex_SetColor( &g->vertices[ i ], dist[ i ] == -1 ? BLACK : WHITE );
+         Vertex_SetDistance( &g->vertices[ i ], dist[ i ] );
+         Vertex_SetPredecessor( &g->vertices[ i ], pred[ i ] );
+      }
+   }
+
+   free( dist );
+   free( pred );
+   free( cur );
+   free( next );
+
+   return ok;
+}
+
+
+//----------------------------------------------------------------------
+//                           Componentes: 
+//----------------------------------------------------------------------
+
+// conjuntos disjuntos (union-find): |parent| y |rank| tienen un elemento por vértice
+static int dsu_find( int parent[], int x )
+{
+   while( parent[ x ] != x )
+   {
+      parent[ x ] = parent[ parent[ x ] ];
+      // compresión de caminos por mitades: cada nodo visitado salta a su abuelo
+      x = parent[ x ];
+   }
+   return x;
+}
+
+static bool dsu_union( int parent[], unsigned char rank[], int a, int b )
+{
+   a = dsu_find( parent, a );
+   b = dsu_find( parent, b );
+
+   if( a == b ) return false;
+
+   if( rank[ a ] < rank[ b ] ) { int tmp = a; a = b; b = tmp; }
+   parent[ b ] = a;
+   if( rank[ a ] == rank[ b ] ) ++rank[ a ];
+
+   return true;
+}
+
+// renombra las etiquetas (que son índices de raíces, con comp[ raíz ] == raíz) como 0, 1, ...
+// en el orden en que aparecen, y cuenta los vértices de cada componente
+static int compact_labels( int n, int comp[], int sizes[] )
+{
+   int* id = (int*) malloc( n * sizeof( int ) );
+   if( !id ) return -1;
+
+   for( int i = 0; i < n; ++i ) id[ i ] = -1;
+
+   int count = 0;
+   for( int i = 0; i < n; ++i )
+   {
+      int root = comp[ i ];
+      if( id[ root ] == -1 )
+      {
+         if( sizes ) sizes[ count ] = 0;
+         id[ root ] = count++;
+      }
+   }
+
+   for( int i = 0; i < n; ++i )
+   {
+      comp[ i ] = id[ comp[ i ] ];
+      if( sizes ) ++sizes[ comp[ i ] ];
+   }
+
+   free( id );
+   return count;
+}
+
+/**
+ * @brief Calcula las componentes conexas de un grafo no dirigido.
+ *
+ * Une los extremos de cada arista en una estructura de conjuntos disjuntos con compresión de
+ * caminos y unión por rango, así que el costo es prácticamente lineal en el número de aristas.
+ *
+ * @param g     El grafo.
+ * @param comp  Arreglo de Graph_GetLen() elementos donde se escribe el número de componente
+ *              (0, 1, ...) de cada vértice, indexado por el índice del vértice.
+ * @param sizes Arreglo de Graph_GetLen() elementos donde se escribe el número de vértices de
+ *              cada componente. Puede ser NULL.
+ *
+ * @return El número de componentes, o -1 si no hubo memoria.
+ *
+ * @pre El grafo es no dirigido.
+ */
+int Graph_ConnectedComponents( Graph* g, int comp[], int sizes[] )
+{
+   assert( g->type == eGraphType_UNDIRECTED );
+
+   const CSR* out = out_edges( g );
+   unsigned char* rank = (unsigned char*) calloc( g->len > 0 ? g->len : 1, 1 );
+   if( !out || !rank )
+   {
+      free( rank );
+      return -1;
+   }
+
+   for( int i = 0; i < g->len; ++i ) comp[ i ] = i;
+
+   for( int u = 0; u < g->len; ++u )
+   {
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         if( u < v ) dsu_union( comp, rank, u, v );
+         // cada arista aparece en ambas listas; basta con verla una vez
+      }
+   }
+
+   for( int i = 0; i < g->len; ++i ) comp[ i ] = dsu_find( comp, i );
+
+   free( rank );
+   return compact_labels( g->len, comp, sizes );
+}
+
+// número de vecinos que se enlazan en la fase de muestreo de Afforest
+#ifndef AFFOREST_ROUNDS
+#define AFFOREST_ROUNDS 2
+#endif
+
+// une los árboles de |u| y |v| colgando la raíz mayor de la menor (Shiloach-Vishkin)
+static void cc_link( int comp[], int u, int v )
+{
+   int p1 = __atomic_load_n( &comp[ u ], __ATOMIC_RELAXED );
+   int p2 = __atomic_load_n( &comp[ v ], __ATOMIC_RELAXED );
+
+   while( p1 != p2 )
+   {
+      int high = p1 > p2 ? p1 : p2;
+      int low = p1 + p2 - high;
+      int p_high = __atomic_load_n( &comp[ high ], __ATOMIC_RELAXED );
+
+      if( p_high == low ) break;
+      if( p_high == high &&
+          __atomic_compare_exchange_n( &comp[ high ], &p_high, low, false,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) break;
+
+      p1 = __atomic_load_n( &comp[ __atomic_load_n( &comp[ high ], __ATOMIC_RELAXED ) ], __ATOMIC_RELAXED );
+      p2 = __atomic_load_n( &comp[ low ], __ATOMIC_RELAXED );
+   }
+}
+
+// hace que cada vértice apunte directamente a la raíz de su árbol
+static void cc_compress( int comp[], int n )
+{
+   #pragma omp parallel for schedule( dynamic, 16384 )
+   for( int i = 0; i < n; ++i )
+   {
+      while( comp[ i ] != comp[ comp[ i ] ] ) comp[ i ] = comp[ comp[ i ] ];
+   }
+}
+
+static int cmp_int( const void* a, const void* b )
+{
+   int x = *(const int*) a;
+   int y = *(const int*) b;
+   return ( x > y ) - ( x < y );
+}
+
+// toma una muestra de etiquetas y devuelve la que más se repite
+static int sample_frequent_label( const int comp[], int n )
+{
+   enum { SAMPLES = 1024 };
+   int sample[ SAMPLES ];
+   unsigned seed = 2023;
+
+   for( int k = 0; k < SAMPLES; ++k )
+   {
+      seed = seed * 1103515245u + 12345u;
+      sample[ k ] = comp[ ( seed >> 8 ) % n ];
+   }
+
+   qsort( sample, SAMPLES, sizeof( int ), cmp_int );
+
+   int best = sample[ 0 ];
+   int best_run = 0;
+   for( int k = 0, run = 0; k < SAMPLES; ++k )
+   {
+      run = ( k > 0 && sample[ k ] == sample[ k - 1 ] ) ? run + 1 : 1;
+      if( run > best_run ) { best_run = run; best = sample[ k ]; }
+   }
+
+   return best;
+}
+
+/**
+ * @brief Versión paralela de Graph_ConnectedComponents() para grafos grandes (Afforest).
+ *
+ * Primero enlaza a cada vértice con unos cuantos de sus vecinos, lo que basta para descubrir
+ * casi por completo a la componente gigante; luego sólo procesa las aristas restantes de los
+ * vértices que quedaron fuera de ella. Los enlaces se hacen con compare-and-swap al estilo de
+ * Shiloach-Vishkin. Los parámetros y el valor de retorno son los de
+ * Graph_ConnectedComponents().
+ *
+ * @pre El grafo es no dirigido.
+ */
+int Graph_ConnectedComponents_Parallel( Graph* g, int comp[], int sizes[] )
+{
+   assert( g->type == eGraphType_UNDIRECTED );
+
+   const CSR* out = out_edges( g );
+   if( !out ) return -1;
+
+   int n = g->len;
+
+   #pragma omp parallel for schedule( static )
+   for( int i = 0; i < n; ++i ) comp[ i ] = i;
+
+   for( int r = 0; r < AFFOREST_ROUNDS; ++r )
+   {
+      #pragma omp parallel for schedule( dynamic, 16384 )
+      for( int u = 0; u < n; ++u )
+      {
+         if( r < csr_degree( out, u ) ) cc_link( comp, u, out->adj[ out->start[ u ] + r ].index );
+      }
+      cc_compress( comp, n );
+   }
+
+   // la componente más frecuente en una muestra pequeña es, casi seguro, la gigante
+   int giant = n > 0 ? sample_frequent_label( comp, n ) : 0;
+
+   #pragma omp parallel for schedule( dynamic, 16384 )
+   for( int u = 0; u < n; ++u )
+   {
+      if( comp[ u ] == giant ) continue;
+
+      for( int e = out->start[ u ] + AFFOREST_ROUNDS; e < out->start[ u + 1 ]; ++e )
+      {
+         cc_link( comp, u, out->adj[ e ].index );
+      }
+   }
+   cc_compress( comp, n );
+
+   return compact_labels( n, comp, sizes );
+}
+
+/**
+ * @brief Calcula las componentes fuertemente conexas de un grafo dirigido (Tarjan).
+ *
+ * La búsqueda en profundidad se hace con una pila explícita, no con recursión, así que no se
+ * desborda la pila del programa aunque el grafo tenga caminos muy largos. Las componentes se
+ * numeran en orden topológico: toda arista entre componentes distintas va de una componente
+ * con número menor a una con número mayor.
+ *
+ * @param g    El grafo.
+ * @param comp Arreglo de Graph_GetLen() elementos donde se escribe el número de componente de
+ *             cada vértice, indexado por el índice del vértice.
+ * @param dag  Si no es NULL, aquí se devuelve el grafo de componentes (condensación) en
+ *             formato CSR: un vértice por componente y una arista c->d si algún vértice de c
+ *             tiene una arista hacia algún vértice de d, con el menor peso entre ellas. El
+ *             cliente debe liberarlo con CSR_Delete().
+ *
+ * @return El número de componentes, o -1 si no hubo memoria.
+ */
+int Graph_StronglyConnectedComponents( Graph* g, int comp[], CSR** dag )
+{
+   const CSR* out = out_edges( g );
+   if( !out ) return -1;
+
+   int n = g->len;
+
+   int* index = (int*) malloc( n * sizeof( int ) );
+   int* low = (int*) malloc( n * sizeof( int ) );
+   int* edge = (int*) malloc( n * sizeof( int ) );  // siguiente arista por revisar de cada vértice
+   int* calls = (int*) malloc( n * sizeof( int ) ); // pila que sustituye a la recursión
+   int* stack = (int*) malloc( n * sizeof( int ) ); // pila de vértices de Tarjan
+
+   int count = -1;
+
+   if( index && low && edge && calls && stack )
+   {
+      for( int i = 0; i < n; ++i )
+      {
+         index[ i ] = -1;
+         comp[ i ] = -1;
+      }
+
+      int counter = 0;
+      int top = 0;
+      count = 0;
+
+      for( int root = 0; root < n; ++root )
+      {
+         if( index[ root ] != -1 ) continue;
+
+         int depth = 0;
+         index[ root ] = low[ root ] = counter++;
+         edge[ root ] = out->start[ root ];
+         stack[ top++ ] = root;
+         calls[ depth++ ] = root;
+
+         while( depth > 0 )
+         {
+            int v = calls[ depth - 1 ];
+
+            if( edge[ v ] < out->start[ v + 1 ] )
+            {
+               int w = out->adj[ edge[ v ]++ ].index;
+
+               if( index[ w ] == -1 )
+               {
+                  index[ w ] = low[ w ] = counter++;
+                  edge[ w ] = out->start[ w ];
+                  stack[ top++ ] = w;
+                  calls[ depth++ ] = w;
+               }
+               else if( comp[ w ] == -1 && index[ w ] < low[ v ] )
+               {
+                  low[ v ] = index[ w ];
+                  // |w| sigue en la pila de Tarjan: es un ancestro o está en la misma componente
+               }
+            }
+            else
+            {
+               --depth;
+               if( depth > 0 && low[ v ] < low[ calls[ depth - 1 ] ] ) low[ calls[ depth - 1 ] ] = low[ v ];
+
+               if( low[ v ] == index[ v ] )
+               {
+                  int w;
+                  do
+                  {
+                     w = stack[ --top ];
+                     comp[ w ] = count;
+                  } while( w != v );
+                  ++count;
+               }
+            }
+         }
+      }
+
+      // Tarjan descubre las componentes en orden topológico inverso
+      for( int i = 0; i < n; ++i ) comp[ i ] = count - 1 - comp[ i ];
+   }
+
+   free( index );
+   free( low );
+   free( edge );
+   free( calls );
+   free( stack );
+
+   if( count >= 0 && dag )
+   {
+      *dag = condensation( out, comp, count );
+      if( !*dag ) count = -1;
+   }
+
+   return count;
+}
+
+
+//----------------------------------------------------------------------
+//                           Centralidad: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Calcula el PageRank (o el PageRank personalizado) de cada vértice.
+ *
+ * Cada iteración "jala" la contribución de los vecinos de entrada de cada vértice sobre el
+ * índice CSR transpuesto, así que cada hilo escribe sólo en sus propios vértices y no hacen
+ * falta operaciones atómicas. La masa de los vértices sin aristas de salida se reparte según
+ * el vector de teletransportación.
+ *
+ * @param g               El grafo.
+ * @param rank            Arreglo de Graph_GetLen() elementos donde se escribe el PageRank de
+ *                        cada vértice (suman 1), indexado por el índice del vértice.
+ * @param damping         Probabilidad de seguir una arista (típicamente 0.85).
+ * @param tolerance       Se detiene cuando la norma L1 del cambio entre iteraciones es menor.
+ * @param max_iters       Número máximo de iteraciones.
+ * @param personalization Vector de teletransportación, indexado por el índice del vértice (no
+ *                        necesita estar normalizado). Si es NULL se usa la distribución
+ *                        uniforme, es decir, el PageRank clásico.
+ *
+ * @return El número de iteraciones realizadas, o -1 si no hubo memoria.
+ */
+int Graph_PageRank( Graph* g, float rank[], float damping, float tolerance, int max_iters,
+                    const float personalization[] )
+{
+   assert( g->len > 0 );
+   assert( 0.0f <= damping && damping < 1.0f );
+
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+
+   int n = g->len;
+
+   float* contrib = (float*) malloc( n * sizeof( float ) );
+   float* inv_degree = (float*) malloc( n * sizeof( float ) );
+   float* teleport = (float*) malloc( n * sizeof( float ) );
+
+   if( !out || !in || !contrib || !inv_degree || !teleport )
+   {
+      free( contrib );
+      free( inv_degree );
+      free( teleport );
+      return -1;
+   }
+
+   double total = 0.0;
+   for( int i = 0; i < n; ++i ) total += personalization ? personalization[ i ] : 1.0f;
+   assert( total > 0.0 );
+
+   for( int i = 0; i < n; ++i )
+   {
+      teleport[ i ] = ( personalization ? personalization[ i ] : 1.0f ) / (float) total;
+      rank[ i ] = teleport[ i ];
+
+      int degree = csr_degree( out, i );
+      inv_degree[ i ] = degree > 0 ? 1.0f / degree : 0.0f;
+      // los vértices colgantes no aportan por sus aristas; su masa se reparte aparte
+   }
+
+   int iter = 0;
+   while( iter < max_iters )
+   {
+      double dangling = 0.0;
+
+      #pragma omp parallel for simd schedule( static ) reduction( +:dangling )
+      for( int i = 0; i < n; ++i )
+      {
+         contrib[ i ] = rank[ i ] * inv_degree[ i ];
+         if( inv_degree[ i ] == 0.0f ) dangling += rank[ i ];
+      }
+
+      float base = (float) ( damping * dangling );
+      double error = 0.0;
+
+      #pragma omp parallel for schedule( dynamic, 1024 ) reduction( +:error )
+      for( int v = 0; v < n; ++v )
+      {
+         float sum = 0.0f;
+         for( int e = in->start[ v ]; e < in->start[ v + 1 ]; ++e )
+         {
+            sum += contrib[ in->adj[ e ].index ];
+         }
+
+         float value = ( 1.0f - damping ) * teleport[ v ] + damping * sum + base * teleport[ v ];
+         error += fabsf( value - rank[ v ] );
+         rank[ v ] = value;
+         // |contrib| ya guarda lo necesario de la iteración anterior, así que podemos
+         // sobreescribir |rank| en su lugar
+      }
+
+      ++iter;
+      if( error < tolerance ) break;
+   }
+
+   free( contrib );
+   free( inv_degree );
+   free( teleport );
+
+   return iter;
+}
+
+// generador xorshift; lo usamos para que las muestras sean reproducibles dada una semilla
+static inline unsigned next_random( unsigned* state )
+{
+   unsigned x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return *state = x;
+}
+
+// memoria de trabajo de cada hilo para el algoritmo de Brandes
+typedef struct
+{
+   double* sigma;  ///< número de caminos más cortos desde la fuente
+   double* delta;  ///< dependencia acumulada
+   float* dist;    ///< distancia desde la fuente; -1 si no se ha alcanzado
+   int* order;     ///< vértices en el orden en que se asentaron
+   int* rank;      ///< posición de cada vértice en |order|; -1 si no se ha asentado
+   double* bc;     ///< acumulador privado de centralidad
+   Heap heap;
+} BrandesScratch;
+
+// una fuente del algoritmo de Brandes: cuenta caminos más cortos hacia adelante y acumula
+// dependencias en orden inverso, usando la forma "por sucesores" para no guardar listas de
+// predecesores
+static bool brandes_source( const CSR* out, int s, bool weighted, BrandesScratch* w )
+{
+   int n = out->n;
+
+   for( int i = 0; i < n; ++i )
+   {
+      w->sigma[ i ] = 0.0;
+      w->delta[ i ] = 0.0;
+      w->dist[ i ] = -1.0f;
+      w->rank[ i ] = -1;
+   }
+
+   int settled = 0;
+   w->sigma[ s ] = 1.0;
+   w->dist[ s ] = 0.0f;
+
+   if( !weighted )
+   {
+      int head = 0;
+      w->rank[ s ] = settled;
+      w->order[ settled++ ] = s;
+
+      while( head < settled )
+      {
+         int v = w->order[ head++ ];
+         for( int e = out->start[ v ]; e < out->start[ v + 1 ]; ++e )
+         {
+            int x = out->adj[ e ].index;
+            if( w->dist[ x ] < 0.0f )
+            {
+               w->dist[ x ] = w->dist[ v ] + 1.0f;
+               w->rank[ x ] = settled;
+               w->order[ settled++ ] = x;
+            }
+            if( w->dist[ x ] == w->dist[ v ] + 1.0f ) w->sigma[ x ] += w->sigma[ v ];
+         }
+      }
+   }
+   else
+   {
+      // con aristas de peso 0 dos vértices pueden quedar a la misma distancia con una arista en
+      // cada sentido; para no contar caminos en ambos sentidos, una arista sólo forma parte de
+      // un camino más corto si su destino se asentó después que su origen
+      heap_clear( &w->heap );
+      if( !heap_push( &w->heap, s, 0.0f ) ) return false;
+
+      while( !heap_is_empty( &w->heap ) )
+      {
+         Data top = heap_pop( &w->heap );
+         int v = top.index;
+         if( w->rank[ v ] != -1 || top.weight > w->dist[ v ] ) continue;
+
+         w->rank[ v ] = settled;
+         w->order[ settled++ ] = v;
+
+         for( int e = out->start[ v ]; e < out->start[ v + 1 ]; ++e )
+         {
+            int x = out->adj[ e ].index;
+            if( w->rank[ x ] != -1 ) continue;
+
+            float d = w->dist[ v ] + out->adj[ e ].weight;
+
+            if( w->dist[ x ] < 0.0f || d < w->dist[ x ] )
+            {
+               w->dist[ x ] = d;
+               w->sigma[ x ] = w->sigma[ v ];
+               if( !heap_push( &w->heap, x, d ) ) return false;
+            }
+            else if( d == w->dist[ x ] ) w->sigma[ x ] += w->sigma[ v ];
+         }
+      }
+   }
+
+   for( int k = settled - 1; k >= 0; --k )
+   {
+      int v = w->order[ k ];
+      for( int e = out->start[ v ]; e < out->start[ v + 1 ]; ++e )
+      {
+         int x = out->adj[ e ].index;
+         float step = weighted ? out->adj[ e ].weight : 1.0f;
+
+         if( w->dist[ x ] == w->dist[ v ] + step && w->rank[ x ] > k && w->sigma[ x ] > 0.0 )
+         {
+            w->delta[ v ] += w->sigma[ v ] / w->sigma[ x ] * ( 1.0 + w->delta[ x ] );
+         }
+      }
+      if( v != s ) w->bc[ v ] += w->delta[ v ];
+   }
+
+   return true;
+}
+
+/**
+ * @brief Calcula la centralidad de intermediación (betweenness) de cada vértice (Brandes).
+ *
+ * Las fuentes se reparten entre los hilos; cada hilo acumula las dependencias en su propio
+ * arreglo y al final se suman. En modo aproximado sólo se procesan |samples| fuentes elegidas
+ * al azar y el resultado se escala por n / samples, que es un estimador insesgado; usa
+ * Graph_BetweennessSamples() para elegir |samples| a partir del error tolerado.
+ *
+ * @param g        El grafo.
+ * @param bc       Arreglo de Graph_GetLen() elementos donde se escribe la centralidad de cada
+ *                 vértice, indexado por el índice del vértice. En grafos no dirigidos cada par
+ *                 de vértices se cuenta una sola vez.
+ * @param weighted true para usar los pesos de las aristas; false para contar aristas. Con pesos,
+ *                 dos caminos se consideran igual de cortos sólo si sus longitudes coinciden
+ *                 exactamente en punto flotante. Entre vértices a la misma distancia (unidos
+ *                 por aristas de peso 0) una arista cuenta sólo en el sentido en que se
+ *                 asentaron los vértices.
+ * @param samples  Número de fuentes a muestrear; 0 (o un valor mayor o igual que el número de
+ *                 vértices) calcula el valor exacto.
+ * @param seed     Semilla para elegir las fuentes en modo aproximado.
+ *
+ * @return El número de fuentes procesadas, o -1 si no hubo memoria.
+ *
+ * @pre Los pesos no son negativos.
+ */
+int Graph_Betweenness( Graph* g, float bc[], bool weighted, int samples, unsigned seed )
+{
+   assert( g->len > 0 );
+
+   const CSR* out = out_edges( g );
+   if( !out ) return -1;
+
+   int n = g->len;
+   int* sources = (int*) malloc( n * sizeof( int ) );
+   double* total = (double*) calloc( n, sizeof( double ) );
+   if( !sources || !total )
+   {
+      free( sources );
+      free( total );
+      return -1;
+   }
+
+   for( int i = 0; i < n; ++i ) sources[ i ] = i;
+
+   int k = n;
+   if( samples > 0 && samples < n )
+   {
+      // Fisher-Yates parcial: las primeras |samples| posiciones quedan con fuentes distintas
+      unsigned state = seed ? seed : 2463534242u;
+      for( int i = 0; i < samples; ++i )
+      {
+         int j = i + (int) ( next_random( &state ) % (unsigned) ( n - i ) );
+         int tmp = sources[ i ];
+         sources[ i ] = sources[ j ];
+         sources[ j ] = tmp;
+      }
+      k = samples;
+   }
+
+   bool ok = true;
+
+   #pragma omp parallel
+   {
+      BrandesScratch w;
+      w.sigma = (double*) malloc( n * sizeof( double ) );
+      w.delta = (double*) malloc( n * sizeof( double ) );
+      w.dist = (float*) malloc( n * sizeof( float ) );
+      w.order = (int*) malloc( n * sizeof( int ) );
+      w.rank = (int*) malloc( n * sizeof( int ) );
+      w.bc = (double*) calloc( n, sizeof( double ) );
+      w.heap.items = NULL;
+      w.heap.len = w.heap.cap = 0;
+
+      bool mine = w.sigma && w.delta && w.dist && w.order && w.rank && w.bc;
+
+      #pragma omp for schedule( dynamic, 1 )
+      for( int i = 0; i < k; ++i )
+      {
+         if( mine ) mine = brandes_source( out, sources[ i ], weighted, &w );
+      }
+
+      #pragma omp critical
+      {
+         if( mine )
+         {
+            for( int i = 0; i < n; ++i ) total[ i ] += w.bc[ i ];
+         }
+         else ok = false;
+      }
+
+      free( w.sigma );
+      free( w.delta );
+      free( w.dist );
+      free( w.order );
+      free( w.rank );
+      free( w.bc );
+      heap_free( &w.heap );
+   }
+
+   double scale = (double) n / k;
+   if( g->type == eGraphType_UNDIRECTED ) scale /= 2.0;
+
+   for( int i = 0; i < n; ++i ) bc[ i ] = (float) ( total[ i ] * scale );
+
+   free( sources );
+   free( total );
+
+   return ok ? k : -1;
+}
+
+/**
+ * @brief Número de fuentes a muestrear en Graph_Betweenness() para una precisión dada.
+ *
+ * Por la desigualdad de Hoeffding y la cota de la unión sobre todos los vértices, con este
+ * número de fuentes la centralidad estimada de todos los vértices, normalizada por
+ * (n - 1)(n - 2), difiere de la exacta en menos de |epsilon| con probabilidad de al menos
+ * 1 - |delta|.
+ *
+ * @param g       El grafo.
+ * @param epsilon Error absoluto tolerado sobre la centralidad normalizada.
+ * @param delta   Probabilidad tolerada de exceder el error.
+ *
+ * @return El número de fuentes a muestrear.
+ */
+int Graph_BetweennessSamples( const Graph* g, double epsilon, double delta )
+{
+   assert( epsilon > 0.0 && delta > 0.0 && delta < 1.0 );
+
+   double k = ceil( log( 2.0 * g->len / delta ) / ( 2.0 * epsilon * epsilon ) );
+
+   return k < g->len ? (int) k : g->len;
+}
+
+
+//----------------------------------------------------------------------
+//                           Árboles de expansión: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Una arista del grafo, con sus extremos dados por índice.
+ */
+typedef struct
+{
+   int start;    ///< índice del vértice de salida
+   int finish;   ///< índice del vértice de llegada
+   float weight; ///< peso de la arista
+} Edge;
+
+// convierte un float en un entero sin signo que se ordena igual que el float
+static inline uint32_t float_key( float f )
+{
+   uint32_t bits;
+   memcpy( &bits, &f, sizeof( bits ) );
+   return ( bits & 0x80000000u ) ? ~bits : ( bits | 0x80000000u );
+}
+
+// copia cada arista no dirigida una sola vez (la de start < finish)
+static int undirected_edges( const CSR* out, Edge** p_edges )
+{
+   int m = 0;
+   for( int u = 0; u < out->n; ++u )
+   {
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         if( u < out->adj[ e ].index ) ++m;
+      }
+   }
+
+   Edge* edges = (Edge*) malloc( ( m > 0 ? m : 1 ) * sizeof( Edge ) );
+   if( !edges ) return -1;
+
+   int k = 0;
+   for( int u = 0; u < out->n; ++u )
+   {
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         if( u < out->adj[ e ].index )
+         {
+            edges[ k ].start = u;
+            edges[ k ].finish = out->adj[ e ].index;
+            edges[ k ].weight = out->adj[ e ].weight;
+            ++k;
+         }
+      }
+   }
+
+   *p_edges = edges;
+   return m;
+}
+
+// ordena las aristas por peso con radix sort LSD de 4 pasadas de 8 bits (estable)
+static bool radix_sort_edges( Edge edges[], int m )
+{
+   Edge* tmp = (Edge*) malloc( ( m > 0 ? m : 1 ) * sizeof( Edge ) );
+   if( !tmp ) return false;
+
+   Edge* src = edges;
+   Edge* dst = tmp;
+
+   for( int shift = 0; shift < 32; shift += 8 )
+   {
+      int count[ 257 ] = { 0 };
+
+      for( int i = 0; i < m; ++i ) ++count[ ( ( float_key( src[ i ].weight ) >> shift ) & 0xff ) + 1 ];
+      for( int b = 0; b < 256; ++b ) count[ b + 1 ] += count[ b ];
+      for( int i = 0; i < m; ++i ) dst[ count[ ( float_key( src[ i ].weight ) >> shift ) & 0xff ]++ ] = src[ i ];
+
+      Edge* swap = src;
+      src = dst;
+      dst = swap;
+   }
+   // con un número par de pasadas el resultado queda otra vez en |edges|
+
+   free( tmp );
+   return true;
+}
+
+/**
+ * @brief Calcula el bosque de expansión de peso mínimo de un grafo no dirigido (Kruskal).
+ *
+ * Ordena las aristas por peso con radix sort y las va agregando, en ese orden, siempre que
+ * no cierren un ciclo, lo que se verifica con conjuntos disjuntos. Si el grafo no es conexo
+ * el resultado es un árbol por cada componente.
+ *
+ * @param g     El grafo.
+ * @param mst   Arreglo de al menos Graph_GetLen() - 1 elementos donde se escriben las aristas
+ *              del bosque.
+ * @param total Si no es NULL, aquí se escribe la suma de los pesos del bosque.
+ *
+ * @return El número de aristas escritas en |mst|, o -1 si no hubo memoria.
+ *
+ * @pre El grafo es no dirigido.
+ */
+int Graph_MinimumSpanningForest( Graph* g, Edge mst[], float* total )
+{
+   assert( g->type == eGraphType_UNDIRECTED );
+
+   const CSR* out = out_edges( g );
+   if( !out ) return -1;
+
+   Edge* edges = NULL;
+   int m = undirected_edges( out, &edges );
+   if( m < 0 ) return -1;
+
+   int* parent = (int*) malloc( g->len * sizeof( int ) );
+   unsigned char* rank = (unsigned char*) calloc( g->len, 1 );
+
+   int count = -1;
+
+   if( parent && rank && radix_sort_edges( edges, m ) )
+   {
+      for( int i = 0; i < g->len; ++i ) parent[ i ] = i;
+
+      double sum = 0.0;
+      count = 0;
+      for( int i = 0; i < m && count < g->len - 1; ++i )
+      {
+         if( dsu_union( parent, rank, edges[ i ].start, edges[ i ].finish ) )
+         {
+            mst[ count++ ] = edges[ i ];
+            sum += edges[ i ].weight;
+         }
+      }
+
+      if( total ) *total = (float) sum;
+   }
+
+   free( edges );
+   free( parent );
+   free( rank );
+
+   return count;
+}
+
+/**
+ * @brief Versión paralela de Graph_MinimumSpanningForest() (Borůvka).
+ *
+ * En cada ronda todos los hilos recorren las aristas y cada componente se queda, mediante un
+ * mínimo atómico, con su arista más ligera hacia otra componente; luego se agregan esas
+ * aristas y se fusionan las componentes. El número de componentes al menos se reduce a la
+ * mitad en cada ronda. Los empates se rompen por posición de la arista, así que el resultado
+ * es el mismo bosque que el de Kruskal. Los parámetros y el valor de retorno son los de
+ * Graph_MinimumSpanningForest().
+ *
+ * @pre El grafo es no dirigido.
+ */
+int Graph_MinimumSpanningForest_Boruvka( Graph* g, Edge mst[], float* total )
+{
+   assert( g->type == eGraphType_UNDIRECTED );
+
+   const CSR* out = out_edges( g );
+   if( !out ) return -1;
+
+   Edge* edges = NULL;
+   int m = undirected_edges( out, &edges );
+   if( m < 0 ) return -1;
+
+   int n = g->len;
+   int* label = (int*) malloc( n * sizeof( int ) );
+   int* parent = (int*) malloc( n * sizeof( int ) );
+   unsigned char* rank = (unsigned char*) calloc( n, 1 );
+   uint64_t* best = (uint64_t*) malloc( n * sizeof( uint64_t ) );
+
+   int count = -1;
+
+   if( label && parent && rank && best )
+   {
+      for( int i = 0; i < n; ++i ) label[ i ] = parent[ i ] = i;
+
+      double sum = 0.0;
+      count = 0;
+
+      bool merged = true;
+      while( merged )
+      {
+         #pragma omp parallel for schedule( static )
+         for( int i = 0; i < n; ++i ) best[ i ] = UINT64_MAX;
+
+         // la arista candidata se codifica como (peso ordenable, posición) para comparar ambos
+         // criterios con un solo mínimo atómico de 64 bits
+         #pragma omp parallel for schedule( dynamic, 4096 )
+         for( int i = 0; i < m; ++i )
+         {
+            int cu = label[ edges[ i ].start ];
+            int cv = label[ edges[ i ].finish ];
+            if( cu == cv ) continue;
+
+            uint64_t key = ( (uint64_t) float_key( edges[ i ].weight ) << 32 ) | (uint32_t) i;
+            int ends[ 2 ] = { cu, cv };
+
+            for( int k = 0; k < 2; ++k )
+            {
+               uint64_t cur = __atomic_load_n( &best[ ends[ k ] ], __ATOMIC_RELAXED );
+               while( key < cur &&
+                      !__atomic_compare_exchange_n( &best[ ends[ k ] ], &cur, key, false,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+                  ;
+            }
+         }
+
+         merged = false;
+         for( int c = 0; c < n; ++c )
+         {
+            if( best[ c ] == UINT64_MAX ) continue;
+
+            Edge e = edges[ (uint32_t) best[ c ] ];
+            if( dsu_union( parent, rank, e.start, e.finish ) )
+            {
+               mst[ count++ ] = e;
+               sum += e.weight;
+               merged = true;
+            }
+            // si ambas componentes eligieron la misma arista, la segunda vez ya no une nada
+         }
+
+         for( int i = 0; i < n; ++i ) label[ i ] = dsu_find( parent, i );
+      }
+
+      if( total ) *total = (float) sum;
+   }
+
+   free( edges );
+   free( label );
+   free( parent );
+   free( rank );
+   free( best );
+
+   return count;
+}
+
+
+//----------------------------------------------------------------------
+//                           Triángulos: 
+//----------------------------------------------------------------------
+
+// cuenta los elementos comunes de los arreglos ordenados |a| y |b| (sin repetidos) y, si
+// |counts| no es NULL, le suma uno a cada elemento común. Con SSE2 compara bloques de 4 contra
+// 4 elementos a la vez.
+static long intersect_count( const int* a, int na, const int* b, int nb, long counts[] )
+{
+   long found = 0;
+   int i = 0;
+   int j = 0;
+
+#ifdef __SSE2__
+   while( i + 4 <= na && j + 4 <= nb )
+   {
+      __m128i va = _mm_loadu_si128( (const __m128i*) &a[ i ] );
+      __m128i vb = _mm_loadu_si128( (const __m128i*) &b[ j ] );
+
+      __m128i eq = _mm_cmpeq_epi32( va, vb );
+      eq = _mm_or_si128( eq, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE( 0, 3, 2, 1 ) ) ) );
+      eq = _mm_or_si128( eq, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE( 1, 0, 3, 2 ) ) ) );
+      eq = _mm_or_si128( eq, _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, _MM_SHUFFLE( 2, 1, 0, 3 ) ) ) );
+
+      int mask = _mm_movemask_ps( _mm_castsi128_ps( eq ) );
+      // un bit por cada elemento del bloque de |a| que aparece en el bloque de |b|
+
+      found += __builtin_popcount( mask );
+      if( counts )
+      {
+         while( mask )
+         {
+            __atomic_fetch_add( &counts[ a[ i + __builtin_ctz( mask ) ] ], 1, __ATOMIC_RELAXED );
+            mask &= mask - 1;
+         }
+      }
+
+      int a_max = a[ i + 3 ];
+      int b_max = b[ j + 3 ];
+      if( a_max <= b_max ) i += 4;
+      if( b_max <= a_max ) j += 4;
+   }
+#endif
+
+   while( i < na && j < nb )
+   {
+      if( a[ i ] < b[ j ] ) ++i;
+      else if( a[ i ] > b[ j ] ) ++j;
+      else
+      {
+         ++found;
+         if( counts ) __atomic_fetch_add( &counts[ a[ i ] ], 1, __ATOMIC_RELAXED );
+         ++i;
+         ++j;
+      }
+   }
+
+   return found;
+}
+
+/**
+ * @brief Cuenta los triángulos de un grafo no dirigido.
+ *
+ * Orienta cada arista del vértice de menor grado al de mayor grado (desempatando por índice),
+ * de modo que cada triángulo aparece una sola vez y las listas que se intersectan son cortas
+ * aun en presencia de concentradores. Las listas orientadas se ordenan y se intersectan por
+ * mezcla. Los vértices se reparten entre los hilos.
+ *
+ * @param g          El grafo.
+ * @param per_vertex Arreglo de Graph_GetLen() elementos donde se escribe el número de
+ *                   triángulos en los que participa cada vértice. Puede ser NULL.
+ *
+ * @return El número total de triángulos, o -1 si no hubo memoria.
+ *
+ * @pre El grafo es no dirigido.
+ */
+long Graph_CountTriangles( Graph* g, long per_vertex[] )
+{
+   assert( g->type == eGraphType_UNDIRECTED );
+
+   const CSR* out = out_edges( g );
+   if( !out ) return -1;
+
+   int n = g->len;
+   int* start = (int*) malloc( ( n + 1 ) * sizeof( int ) );
+   int* adj = (int*) malloc( ( out->m / 2 + 1 ) * sizeof( int ) );
+
+   if( !start || !adj )
+   {
+      free( start );
+      free( adj );
+      return -1;
+   }
+
+   // la arista u-v se queda sólo en la lista de u si u "precede" a v
+   #define PRECEDES( u, v ) ( csr_degree( out, u ) < csr_degree( out, v ) || \
+                              ( csr_degree( out, u ) == csr_degree( out, v ) && (u) < (v) ) )
+
+   int pos = 0;
+   for( int u = 0; u < n; ++u )
+   {
+      start[ u ] = pos;
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         if( PRECEDES( u, v ) ) adj[ pos++ ] = v;
+      }
+   }
+   start[ n ] = pos;
+
+   #undef PRECEDES
+
+   #pragma omp parallel for schedule( dynamic, 256 )
+   for( int u = 0; u < n; ++u )
+   {
+      qsort( &adj[ start[ u ] ], start[ u + 1 ] - start[ u ], sizeof( int ), cmp_int );
+   }
+
+   if( per_vertex )
+   {
+      for( int i = 0; i < n; ++i ) per_vertex[ i ] = 0;
+   }
+
+   long total = 0;
+
+   #pragma omp parallel for schedule( dynamic, 64 ) reduction( +:total )
+   for( int u = 0; u < n; ++u )
+   {
+      for( int k = start[ u ]; k < start[ u + 1 ]; ++k )
+      {
+         int v = adj[ k ];
+         long found = intersect_count( &adj[ start[ u ] ], start[ u + 1 ] - start[ u ],
+                                       &adj[ start[ v ] ], start[ v + 1 ] - start[ v ],
+                                       per_vertex );
+         if( per_vertex && found > 0 )
+         {
+            __atomic_fetch_add( &per_vertex[ u ], found, __ATOMIC_RELAXED );
+            __atomic_fetch_add( &per_vertex[ v ], found, __ATOMIC_RELAXED );
+         }
+         total += found;
+      }
+   }
+
+   free( start );
+   free( adj );
+
+   return total;
+}
+
+/**
+ * @brief Calcula el coeficiente de agrupamiento (clustering coefficient) de un grafo no
+ * dirigido.
+ *
+ * @param g     El grafo.
+ * @param local Arreglo de Graph_GetLen() elementos donde se escribe el coeficiente local de
+ *              cada vértice: la fracción de pares de vecinos que también son vecinos entre sí
+ *              (0 si tiene menos de dos vecinos). Puede ser NULL.
+ *
+ * @return El coeficiente global (transitividad): 3 veces el número de triángulos entre el
+ * número de caminos de longitud 2; -1 si no hubo memoria.
+ *
+ * @pre El grafo es no dirigido.
+ */
+float Graph_ClusteringCoefficient( Graph* g, float local[] )
+{
+   assert( g->type == eGraphType_UNDIRECTED );
+
+   long* per_vertex = (long*) malloc( g->len * sizeof( long ) );
+   if( !per_vertex ) return -1.0f;
+
+   long triangles = Graph_CountTriangles( g, per_vertex );
+   if( triangles < 0 )
+   {
+      free( per_vertex );
+      return -1.0f;
+   }
+
+   const CSR* out = g->out;
+   double wedges = 0.0;
+
+   for( int i = 0; i < g->len; ++i )
+   {
+      double d = csr_degree( out, i );
+      double pairs = d * ( d - 1.0 ) / 2.0;
+
+      wedges += pairs;
+      if( local ) local[ i ] = pairs > 0.0 ? (float) ( per_vertex[ i ] / pairs ) : 0.0f;
+   }
+
+   free( per_vertex );
+
+   return wedges > 0.0 ? (float) ( 3.0 * triangles / wedges ) : 0.0f;
+}
+
+
+//----------------------------------------------------------------------
+//                           Núcleos (k-cores): 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Calcula el número de núcleo (core number) de cada vértice (Batagelj-Zaversnik).
+ *
+ * El k-núcleo es el subgrafo máximo en el que todos los vértices tienen al menos k vecinos;
+ * el número de núcleo de un vértice es la k más grande tal que el vértice está en el
+ * k-núcleo. Los vértices se mantienen ordenados por grado en cubetas y se retiran del de menor
+ * grado al de mayor, así que el costo es lineal en el tamaño del grafo. En los grafos
+ * dirigidos se ignora la dirección y se usa el grado total (entrada más salida).
+ *
+ * @param g    El grafo.
+ * @param core Arreglo de Graph_GetLen() elementos donde se escribe el número de núcleo de
+ *             cada vértice, indexado por el índice del vértice.
+ *
+ * @return El número de núcleo más grande, o -1 si no hubo memoria.
+ */
+int Graph_CoreNumbers( Graph* g, int core[] )
+{
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+   if( !out || !in ) return -1;
+
+   const CSR* lists[ 2 ] = { out, in };
+   int nlists = out == in ? 1 : 2;
+
+   int n = g->len;
+   int max_degree = 0;
+
+   for( int v = 0; v < n; ++v )
+   {
+      core[ v ] = csr_degree( out, v ) + ( nlists == 2 ? csr_degree( in, v ) : 0 );
+      if( core[ v ] > max_degree ) max_degree = core[ v ];
+   }
+
+   int* bin = (int*) calloc( max_degree + 1, sizeof( int ) );
+   int* pos = (int*) malloc( n * sizeof( int ) );
+   int* vert = (int*) malloc( n * sizeof( int ) );
+
+   if( !bin || !pos || !vert )
+   {
+      free( bin );
+      free( pos );
+      free( vert );
+      return -1;
+   }
+
+   // |vert| queda ordenado por grado; bin[ d ] es donde empieza la cubeta de grado d
+   for( int v = 0; v < n; ++v ) ++bin[ core[ v ] ];
+   for( int d = 0, first = 0; d <= max_degree; ++d )
+   {
+      int count = bin[ d ];
+      bin[ d ] = first;
+      first += count;
+   }
+   for( int v = 0; v < n; ++v )
+   {
+      pos[ v ] = bin[ core[ v ] ]++;
+      vert[ pos[ v ] ] = v;
+   }
+   for( int d = max_degree; d > 0; --d ) bin[ d ] = bin[ d - 1 ];
+   bin[ 0 ] = 0;
+
+   int max_core = 0;
+
+   for( int i = 0; i < n; ++i )
+   {
+      int v = vert[ i ];
+      if( core[ v ] > max_core ) max_core = core[ v ];
+
+      for( int l = 0; l < nlists; ++l )
+      {
+         const CSR* csr = lists[ l ];
+         for( int e = csr->start[ v ]; e < csr->start[ v + 1 ]; ++e )
+         {
+            int u = csr->adj[ e ].index;
+            if( core[ u ] > core[ v ] )
+            {
+               // pasamos a |u| al principio de su cubeta y recorremos la frontera de la cubeta,
+               // con lo que |u| queda en la cubeta del grado inmediato inferior
+               int du = core[ u ];
+               int pu = pos[ u ];
+               int pw = bin[ du ];
+               int w = vert[ pw ];
+
+               if( u != w )
+               {
+                  pos[ u ] = pw;
+                  vert[ pu ] = w;
+                  pos[ w ] = pu;
+                  vert[ pw ] = u;
+               }
+               ++bin[ du ];
+               --core[ u ];
+            }
+         }
+      }
+   }
+
+   free( bin );
+   free( pos );
+   free( vert );
+
+   return max_core;
+}
+
+/**
+ * @brief Versión paralela de Graph_CoreNumbers() que retira a los vértices por niveles.
+ *
+ * Para cada k, se retiran en paralelo todos los vértices con grado restante a lo más k; los
+ * vecinos cuyo grado baja a k con un decremento atómico entran a la siguiente ronda del mismo
+ * nivel. Los parámetros y el valor de retorno son los de Graph_CoreNumbers().
+ */
+int Graph_CoreNumbers_Parallel( Graph* g, int core[] )
+{
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+   if( !out || !in ) return -1;
+
+   const CSR* lists[ 2 ] = { out, in };
+   int nlists = out == in ? 1 : 2;
+
+   int n = g->len;
+
+   int* degree = (int*) malloc( n * sizeof( int ) );
+   char* removed = (char*) calloc( n, 1 );
+   int* cur = (int*) malloc( n * sizeof( int ) );
+   int* next = (int*) malloc( n * sizeof( int ) );
+
+   if( !degree || !removed || !cur || !next )
+   {
+      free( degree );
+      free( removed );
+      free( cur );
+      free( next );
+      return -1;
+   }
+
+   #pragma omp parallel for schedule( static )
+   for( int v = 0; v < n; ++v )
+   {
+      degree[ v ] = csr_degree( out, v ) + ( nlists == 2 ? csr_degree( in, v ) : 0 );
+   }
+
+   int done = 0;
+   int k = 0;
+
+   while( done < n )
+   {
+      // siguiente nivel: el menor grado entre los vértices que quedan
+      int min_degree = INT_MAX;
+      int cur_len = 0;
+
+      #pragma omp parallel for schedule( static ) reduction( min:min_degree )
+      for( int v = 0; v < n; ++v )
+      {
+         if( !removed[ v ] && degree[ v ] < min_degree ) min_degree = degree[ v ];
+      }
+      if( min_degree > k ) k = min_degree;
+
+      for( int v = 0; v < n; ++v )
+      {
+         if( !removed[ v ] && degree[ v ] <= k ) cur[ cur_len++ ] = v;
+      }
+
+      while( cur_len > 0 )
+      {
+         int next_len = 0;
+
+         #pragma omp parallel for schedule( static )
+         for( int q = 0; q < cur_len; ++q )
+         {
+            removed[ cur[ q ] ] = 1;
+            core[ cur[ q ] ] = k;
+         }
+
+         #pragma omp parallel for schedule( dynamic, 64 )
+         for( int q = 0; q < cur_len; ++q )
+         {
+            int v = cur[ q ];
+            for( int l = 0; l < nlists; ++l )
+            {
+               const CSR* csr = lists[ l ];
+               for( int e = csr->start[ v ]; e < csr->start[ v + 1 ]; ++e )
+               {
+                  int u = csr->adj[ e ].index;
+                  if( removed[ u ] ) continue;
+
+                  if( __atomic_fetch_sub( &degree[ u ], 1, __ATOMIC_RELAXED ) == k + 1 )
+                  {
+                     next[ __atomic_fetch_add( &next_len, 1, __ATOMIC_RELAXED ) ] = u;
+                     // sólo el decremento que cruza de k + 1 a k lo agrega
+                  }
+               }
+            }
+         }
+
+         done += cur_len;
+
+         int* tmp = cur;
+         cur = next;
+         next = tmp;
+         cur_len = next_len;
+      }
+   }
+
+   free( degree );
+   free( removed );
+   free( cur );
+   free( next );
+
+   return n > 0 ? k : 0;
+}
+
+
+//----------------------------------------------------------------------
+//                           Caminos más cortos: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Libera la memoria de un camino devuelto por alguna función del grafo.
+ *
+ * @param path El camino; queda vacío.
+ */
+void Path_Clear( Path* path )
+{
+   free( path->vertices );
+   path->vertices = NULL;
+   path->len = 0;
+   path->cost = 0.0f;
+}
+
+/**
+ * @brief Calcula el camino de menor peso entre dos vértices (Dijkstra).
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vértice de llegada (el dato)
+ * @param path   Aquí se devuelve el camino; el cliente lo debe liberar con Path_Clear().
+ *
+ * @return false si uno o ambos vértices no existen, si no hay camino o si no hubo memoria; true
+ * en caso contrario.
+ *
+ * @pre Los pesos no son negativos.
+ */
+bool Graph_ShortestPath( Graph* g, int start, int finish, Path* path )
+{
+   assert( g->len > 0 );
+
+   int start_idx = find_key( g, start );
+   int finish_idx = find_key( g, finish );
+
+   if( start_idx == -1 || finish_idx == -1 ) return false;
+
+   const CSR* out = out_edges( g );
+   Search* s = graph_search( g );
+   if( !out || !s ) return false;
+
+   if( !search_run( s, out, start_idx, finish_idx, INFINITY, NULL, NULL, NULL ) ) return false;
+   if( s->dist[ finish_idx ] == INFINITY ) return false;
+
+   return search_path( s, finish_idx, path );
+}
+
+// un candidato de Yen: el camino y el índice del vértice donde se desvió de su padre
+typedef struct
+{
+   Path path;
+   int deviation;
+} YenCandidate;
+
+static bool same_prefix( const Path* a, const Path* b, int len )
+{
+   if( a->len <= len || b->len < len ) return false;
+   return memcmp( a->vertices, b->vertices, len * sizeof( int ) ) == 0;
+}
+
+static bool same_path( const Path* a, const Path* b )
+{
+   return a->len == b->len && memcmp( a->vertices, b->vertices, a->len * sizeof( int ) ) == 0;
+}
+
+static int cmp_float( const void* a, const void* b )
+{
+   float x = *(const float*) a;
+   float y = *(const float*) b;
+   return ( x > y ) - ( x < y );
+}
+
+/**
+ * @brief Calcula los |k| caminos sin ciclos de menor peso entre dos vértices (Yen).
+ *
+ * Cada camino nuevo se obtiene desviando uno anterior en algún vértice (el vértice "spur") y
+ * completándolo con un camino más corto que evita las aristas ya usadas con la misma raíz y
+ * los vértices de la raíz. Las aristas y vértices prohibidos se marcan en mapas de bits, sin
+ * modificar las listas de vecinos, y todas las búsquedas comparten la misma memoria de
+ * trabajo. Además:
+ *    - (Lawler) sólo se desvía cada camino a partir del vértice donde él mismo se desvió;
+ *    - las búsquedas desde los vértices spur son A*, guiadas por la distancia de cada vértice
+ *      al destino en el grafo completo (calculada una sola vez con una búsqueda hacia atrás);
+ *    - cada búsqueda se detiene al llegar al destino, o antes si su costo ya no puede mejorar
+ *      a los candidatos que de todos modos se van a elegir.
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vértice de llegada (el dato)
+ * @param k      Número de caminos deseado.
+ * @param paths  Arreglo de al menos |k| elementos donde se devuelven los caminos, de menor a
+ *               mayor peso. El cliente debe liberar cada uno con Path_Clear().
+ *
+ * @return El número de caminos encontrados (puede ser menor que |k|), o -1 si uno o ambos
+ * vértices no existen o no hubo memoria.
+ *
+ * @pre Los pesos no son negativos.
+ */
+int Graph_KShortestPaths( Graph* g, int start, int finish, int k, Path paths[] )
+{
+   assert( g->len > 0 );
+   assert( k > 0 );
+
+   int start_idx = find_key( g, start );
+   int finish_idx = find_key( g, finish );
+
+   if( start_idx == -1 || finish_idx == -1 ) return -1;
+
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+   Search* s = graph_search( g );
+   if( !out || !in || !s ) return -1;
+
+   Search* back = search_new( g->len );
+   uint64_t* banned_v = (uint64_t*) calloc( ( g->len + 63 ) / 64, sizeof( uint64_t ) );
+   uint64_t* banned_e = (uint64_t*) calloc( ( out->m + 63 ) / 64 + 1, sizeof( uint64_t ) );
+   int* banned_list = (int*) malloc( ( k + 1 ) * sizeof( int ) );
+   int* deviation = (int*) malloc( k * sizeof( int ) );
+   float* prefix = (float*) malloc( g->len * sizeof( float ) );
+   float* costs = (float*) malloc( sizeof( float ) );
+
+   int cand_len = 0;
+   int cand_cap = 16;
+   YenCandidate* cand = (YenCandidate*) malloc( cand_cap * sizeof( YenCandidate ) );
+
+   int found = 0;
+   bool failed = true;
+
+   if( !back || !banned_v || !banned_e || !banned_list || !deviation || !prefix || !costs || !cand ) goto done;
+
+   // distancias de todos los vértices hacia el destino; el árbol de esta búsqueda también da
+   // el camino más corto
+   if( !search_run( back, in, finish_idx, -1, INFINITY, NULL, NULL, NULL ) ) goto done;
+
+   if( back->dist[ start_idx ] != INFINITY )
+   {
+      paths[ 0 ].len = 0;
+      for( int v = start_idx; v != -1; v = back->pred[ v ] ) ++paths[ 0 ].len;
+
+      paths[ 0 ].vertices = (int*) malloc( paths[ 0 ].len * sizeof( int ) );
+      if( !paths[ 0 ].vertices ) goto done;
+
+      paths[ 0 ].cost = back->dist[ start_idx ];
+      for( int v = start_idx, pos = 0; v != -1; v = back->pred[ v ], ++pos ) paths[ 0 ].vertices[ pos ] = v;
+
+      deviation[ 0 ] = 0;
+      found = 1;
+   }
+
+   while( found > 0 && found < k )
+   {
+      const Path* prev = &paths[ found - 1 ];
+
+      prefix[ 0 ] = 0.0f;
+      for( int i = 1; i < prev->len; ++i )
+      {
+         int e = csr_find_edge( out, prev->vertices[ i - 1 ], prev->vertices[ i ] );
+         prefix[ i ] = prefix[ i - 1 ] + out->adj[ e ].weight;
+      }
+
+      // costo a partir del cual un candidato nuevo ya no puede quedar entre los |k| caminos
+      float bound = INFINITY;
+      int needed = k - found;
+      if( cand_len >= needed )
+      {
+         float* tmp = (float*) realloc( costs, cand_len * sizeof( float ) );
+         if( !tmp ) goto done;
+         costs = tmp;
+
+         for( int c = 0; c < cand_len; ++c ) costs[ c ] = cand[ c ].path.cost;
+         qsort( costs, cand_len, sizeof( float ), cmp_float );
+         bound = costs[ needed - 1 ];
+      }
+
+      for( int i = deviation[ found - 1 ]; i < prev->len - 1; ++i )
+      {
+         int spur = prev->vertices[ i ];
+
+         // prohibimos la siguiente arista de cada camino ya elegido con la misma raíz...
+         int n_banned = 0;
+         for( int a = 0; a < found; ++a )
+         {
+            if( same_prefix( &paths[ a ], prev, i + 1 ) )
+            {
+               int e = csr_find_edge( out, spur, paths[ a ].vertices[ i + 1 ] );
+               bitmap_set( banned_e, e );
+               banned_list[ n_banned++ ] = e;
+            }
+         }
+         // ...y los vértices de la raíz, para que el camino no tenga ciclos
+         for( int r = 0; r < i; ++r ) bitmap_set( banned_v, prev->vertices[ r ] );
+
+         bool ok = search_run( s, out, spur, finish_idx, bound - prefix[ i ], banned_v, banned_e,
+                               back->dist );
+
+         for( int b = 0; b < n_banned; ++b ) banned_e[ banned_list[ b ] >> 6 ] = 0;
+         for( int r = 0; r < i; ++r ) banned_v[ prev->vertices[ r ] >> 6 ] = 0;
+
+         if( !ok ) goto done;
+
+         if( s->dist[ finish_idx ] == INFINITY ) continue;
+
+         float cost = prefix[ i ] + s->dist[ finish_idx ];
+         if( cost > bound ) continue;
+
+         int spur_len = 0;
+         for( int v = finish_idx; v != spur; v = s->pred[ v ] ) ++spur_len;
+
+         Path candidate;
+         candidate.len = i + 1 + spur_len;
+         candidate.cost = cost;
+         candidate.vertices = (int*) malloc( candidate.len * sizeof( int ) );
+         if( !candidate.vertices ) goto done;
+
+         memcpy( candidate.vertices, prev->vertices, ( i + 1 ) * sizeof( int ) );
+         for( int v = finish_idx, pos = candidate.len - 1; v != spur; v = s->pred[ v ], --pos )
+         {
+            candidate.vertices[ pos ] = v;
+         }
+
+         bool duplicated = false;
+         for( int c = 0; c < cand_len && !duplicated; ++c )
+         {
+            duplicated = same_path( &cand[ c ].path, &candidate );
+         }
+         if( duplicated )
+         {
+            Path_Clear( &candidate );
+            continue;
+         }
+
+         if( cand_len == cand_cap )
+         {
+            YenCandidate* tmp = (YenCandidate*) realloc( cand, 2 * cand_cap * sizeof( YenCandidate ) );
+            if( !tmp )
+            {
+               Path_Clear( &candidate );
+               goto done;
+            }
+            cand = tmp;
+            cand_cap *= 2;
+         }
+         cand[ cand_len ].path = candidate;
+         cand[ cand_len ].deviation = i;
+         ++cand_len;
+      }
+
+      if( cand_len == 0 ) break;
+
+      int best = 0;
+      for( int c = 1; c < cand_len; ++c )
+      {
+         if( cand[ c ].path.cost < cand[ best ].path.cost ) best = c;
+      }
+
+      paths[ found ] = cand[ best ].path;
+      deviation[ found ] = cand[ best ].deviation;
+      ++found;
+
+      cand[ best ] = cand[ --cand_len ];
+   }
+
+   failed = false;
+
+done:
+   for( int c = 0; c < cand_len; ++c ) Path_Clear( &cand[ c ].path );
+
+   free( banned_v );
+   free( banned_e );
+   free( banned_list );
+   free( deviation );
+   free( prefix );
+   free( costs );
+   free( cand );
+   search_delete( &back );
+
+   if( failed )
+   {
+      for( int a = 0; a < found; ++a ) Path_Clear( &paths[ a ] );
+      return -1;
+   }
+
+   return found;
+}
+
+
+//----------------------------------------------------------------------
+//                     Todos los pares (Floyd-Warshall): 
+//----------------------------------------------------------------------
+
+// lado de los bloques de la matriz: tres bloques de 64 x 64 floats (48 KB) caben en L2
+#ifndef FW_BLOCK
+#define FW_BLOCK 64
+#endif
+
+// relaja el bloque |c| a través de los bloques |a| (fila i, columna k) y |b| (fila k, columna
+// j), todos de FW_BLOCK x FW_BLOCK dentro de una matriz de |stride| columnas. Los bloques
+// pueden coincidir, como en la fase 1 del algoritmo. |nc| y |na| son los bloques
+// correspondientes de la matriz de siguiente salto; pueden ser NULL.
+static void fw_block( float* c, const float* a, const float* b, int* nc, const int* na, int stride )
+{
+   for( int k = 0; k < FW_BLOCK; ++k )
+   {
+      const float* b_row = &b[ k * stride ];
+
+      for( int i = 0; i < FW_BLOCK; ++i )
+      {
+         float aik = a[ i * stride + k ];
+         if( aik == INFINITY ) continue;
+
+         float* c_row = &c[ i * stride ];
+
+         if( nc )
+         {
+            int hop = na[ i * stride + k ];
+            int* nc_row = &nc[ i * stride ];
+
+            #pragma omp simd
+            for( int j = 0; j < FW_BLOCK; ++j )
+            {
+               float d = aik + b_row[ j ];
+               bool better = d < c_row[ j ];
+               c_row[ j ] = better ? d : c_row[ j ];
+               nc_row[ j ] = better ? hop : nc_row[ j ];
+            }
+         }
+         else
+         {
+            #pragma omp simd
+            for( int j = 0; j < FW_BLOCK; ++j )
+            {
+               float d = aik + b_row[ j ];
+               c_row[ j ] = d < c_row[ j ] ? d : c_row[ j ];
+            }
+         }
+      }
+   }
+}
+
+/**
+ * @brief Calcula las distancias más cortas entre todos los pares de vértices (Floyd-Warshall
+ * por bloques).
+ *
+ * La matriz se procesa en bloques que caben en el caché: en cada ronda primero el bloque de
+ * la diagonal, luego (en paralelo) los bloques de su fila y su columna y al final (en paralelo)
+ * todos los demás. El ciclo interno no tiene saltos, así que el compilador lo vectoriza (por
+ * ejemplo con AVX2 al compilar con -mavx2). Es conveniente para redes regionales densas de
+ * unos cuantos miles de vértices; la matriz ocupa n * n floats.
+ *
+ * @param g    El grafo.
+ * @param next Si no es NULL, aquí se devuelve una matriz de n * n enteros donde
+ *             next[ i * n + j ] es el índice del vértice que sigue a i en un camino más corto
+ *             hacia j, o -1 si no hay camino. El cliente la debe liberar con free(). Con ella
+ *             se reconstruyen los caminos usando AllPairs_Path().
+ *
+ * @return Una matriz de n * n floats, por renglones, donde el elemento [ i * n + j ] es la
+ * distancia del vértice con índice i al vértice con índice j (INFINITY si no hay camino); NULL
+ * si no hubo memoria. El cliente la debe liberar con free().
+ *
+ * @pre Los pesos no son negativos.
+ */
+float* Graph_AllPairsShortestPaths( Graph* g, int** next )
+{
+   const CSR* out = out_edges( g );
+   if( !out ) return NULL;
+
+   int n = g->len;
+   int blocks = ( n + FW_BLOCK - 1 ) / FW_BLOCK;
+   int stride = blocks * FW_BLOCK;
+   // la matriz se rellena hasta un múltiplo del tamaño de bloque; el relleno queda en INFINITY
+
+   size_t cells = (size_t) stride * stride;
+   float* dist = (float*) malloc( cells * sizeof( float ) );
+   int* hop = next ? (int*) malloc( cells * sizeof( int ) ) : NULL;
+
+   if( !dist || ( next && !hop ) )
+   {
+      free( dist );
+      free( hop );
+      return NULL;
+   }
+
+   #pragma omp parallel for schedule( static )
+   for( int i = 0; i < stride; ++i )
+   {
+      for( int j = 0; j < stride; ++j )
+      {
+         dist[ (size_t) i * stride + j ] = i == j ? 0.0f : INFINITY;
+         if( hop ) hop[ (size_t) i * stride + j ] = i == j && i < n ? i : -1;
+      }
+
+      if( i < n )
+      {
+         for( int e = out->start[ i ]; e < out->start[ i + 1 ]; ++e )
+         {
+            int j = out->adj[ e ].index;
+            if( j != i && out->adj[ e ].weight < dist[ (size_t) i * stride + j ] )
+            {
+               dist[ (size_t) i * stride + j ] = out->adj[ e ].weight;
+               if( hop ) hop[ (size_t) i * stride + j ] = j;
+            }
+         }
+      }
+   }
+
+   #define BLOCK( m, bi, bj ) ( (m) ? &(m)[ (size_t) (bi) * FW_BLOCK * stride + (size_t) (bj) * FW_BLOCK ] : NULL )
+
+   for( int kb = 0; kb < blocks; ++kb )
+   {
+      fw_block( BLOCK( dist, kb, kb ), BLOCK( dist, kb, kb ), BLOCK( dist, kb, kb ),
+                BLOCK( hop, kb, kb ), BLOCK( hop, kb, kb ), stride );
+
+      #pragma omp parallel for schedule( dynamic, 1 )
+      for( int t = 0; t < 2 * blocks; ++t )
+      {
+         int b = t / 2;
+         if( b == kb ) continue;
+
+         if( t % 2 == 0 )
+         {
+            // bloque de la fila kb
+            fw_block( BLOCK( dist, kb, b ), BLOCK( dist, kb, kb ), BLOCK( dist, kb, b ),
+                      BLOCK( hop, kb, b ), BLOCK( hop, kb, kb ), stride );
+         }
+         else
+         {
+            // bloque de la columna kb
+            fw_block( BLOCK( dist, b, kb ), BLOCK( dist, b, kb ), BLOCK( dist, kb, kb ),
+                      BLOCK( hop, b, kb ), BLOCK( hop, b, kb ), stride );
+         }
+      }
+
+      #pragma omp parallel for collapse( 2 ) schedule( dynamic, 1 )
+      for( int ib = 0; ib < blocks; ++ib )
+      {
+         for( int jb = 0; jb < blocks; ++jb )
+         {
+            if( ib == kb || jb == kb ) continue;
+
+            fw_block( BLOCK( dist, ib, jb ), BLOCK( dist, ib, kb ), BLOCK( dist, kb, jb ),
+                      BLOCK( hop, ib, jb ), BLOCK( hop, ib, kb ), stride );
+         }
+      }
+   }
+
+   #undef BLOCK
+
+   // compactamos las matrices a n * n quitando el relleno
+   for( int i = 0; i < n; ++i )
+   {
+      memmove( &dist[ (size_t) i * n ], &dist[ (size_t) i * stride ], n * sizeof( float ) );
+      if( hop ) memmove( &hop[ (size_t) i * n ], &hop[ (size_t) i * stride ], n * sizeof( int ) );
+   }
+
+   if( next ) *next = hop;
+
+   return dist;
+}
+
+/**
+ * @brief Reconstruye un camino a partir de las matrices de Graph_AllPairsShortestPaths().
+ *
+ * @param dist   Matriz de distancias.
+ * @param next   Matriz de siguiente salto.
+ * @param n      Número de vértices con que se calcularon las matrices.
+ * @param start  Índice del vértice de salida.
+ * @param finish Índice del vértice de llegada.
+ * @param path   Aquí se devuelve el camino; el cliente lo debe liberar con Path_Clear().
+ *
+ * @return false si no hay camino o no hubo memoria; true en caso contrario.
+ */
+bool AllPairs_Path( const float dist[], const int next[], int n, int start, int finish, Path* path )
+{
+   assert( 0 <= start && start < n && 0 <= finish && finish < n );
+
+   if( next[ (size_t) start * n + finish ] == -1 ) return false;
+
+   int len = 1;
+   for( int v = start; v != finish; v = next[ (size_t) v * n + finish ] ) ++len;
+
+   path->vertices = (int*) malloc( len * sizeof( int ) );
+   if( !path->vertices ) return false;
+
+   path->len = len;
+   path->cost = dist[ (size_t) start * n + finish ];
+
+   int k = 0;
+   for( int v = start; v != finish; v = next[ (size_t) v * n + finish ] ) path->vertices[ k++ ] = v;
+   path->vertices[ k ] = finish;
+
+   return true;
+}
+
+
+//----------------------------------------------------------------------
+//                           Alcance (isócronas): 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Devuelve los vértices alcanzables desde |start| con un costo total de a lo más
+ * |budget| (por ejemplo, "todos los aeropuertos a menos de N horas").
+ *
+ * Es un Dijkstra que se detiene en cuanto la siguiente distancia rebasa el presupuesto. Usa la
+ * memoria de trabajo del grafo, que sólo se limpia en la región explorada, así que el costo es
+ * proporcional al tamaño de esa región y no al número de vértices del grafo.
+ *
+ * @param g      El grafo.
+ * @param start  Vértice de salida (el dato)
+ * @param budget Costo máximo.
+ * @param out    Arreglo donde se escriben los vértices alcanzados: en |index| el índice del
+ *               vértice y en |weight| su costo mínimo desde |start|. Incluye a |start| con
+ *               costo 0. Debe tener espacio para Graph_GetLen() elementos en el peor caso.
+ *
+ * @return El número de vértices escritos en |out|, o -1 si |start| no existe o no hubo memoria.
+ *
+ * @pre Los pesos no son negativos.
+ */
+int Graph_ReachableWithin( Graph* g, int start, float budget, Data out[] )
+{
+   int start_idx = find_key( g, start );
+   if( start_idx == -1 ) return -1;
+
+   const CSR* csr = out_edges( g );
+   Search* s = graph_search( g );
+   if( !csr || !s ) return -1;
+
+   if( !search_run( s, csr, start_idx, -1, budget, NULL, NULL, NULL ) ) return -1;
+
+   // todo vértice con distancia tentativa dentro del presupuesto ya se asentó: su entrada en
+   // el montículo habría salido antes que la que rebasó el presupuesto
+   int count = 0;
+   for( int k = 0; k < s->n_touched; ++k )
+   {
+      int v = s->touched[ k ];
+      if( s->dist[ v ] <= budget )
+      {
+         out[ count ].index = v;
+         out[ count ].weight = s->dist[ v ];
+         ++count;
+      }
+   }
+
+   return count;
+}
+
+/**
+ * @brief Devuelve los vértices alcanzables desde |start| con a lo más |max_hops| aristas (por
+ * ejemplo, "todos los aeropuertos a K conexiones o menos").
+ *
+ * Es un BFS que no expande el último nivel; como Graph_ReachableWithin(), su costo es
+ * proporcional a la región explorada.
+ *
+ * @param g        El grafo.
+ * @param start    Vértice de salida (el dato)
+ * @param max_hops Número máximo de aristas.
+ * @param out      Arreglo donde se escriben los vértices alcanzados, en orden BFS: en |index| el
+ *                 índice del vértice y en |weight| su número mínimo de aristas desde |start|.
+ *                 Debe tener espacio para Graph_GetLen() elementos en el peor caso.
+ *
+ * @return El número de vértices escritos en |out|, o -1 si |start| no existe o no hubo memoria.
+ */
+int Graph_ReachableWithinHops( Graph* g, int start, int max_hops, Data out[] )
+{
+   int start_idx = find_key( g, start );
+   if( start_idx == -1 ) return -1;
+
+   const CSR* csr = out_edges( g );
+   Search* s = graph_search( g );
+   if( !csr || !s ) return -1;
+
+   search_reset( s );
+   search_relax( s, start_idx, 0.0f, -1 );
+
+   // la lista de vértices tocados hace las veces de la cola del BFS
+   for( int q = 0; q < s->n_touched; ++q )
+   {
+      int u = s->touched[ q ];
+      float hops = s->dist[ u ];
+
+      out[ q ].index = u;
+      out[ q ].weight = hops;
+
+      if( hops >= max_hops ) continue;
+
+      for( int e = csr->start[ u ]; e < csr->start[ u + 1 ]; ++e )
+      {
+         int v = csr->adj[ e ].index;
+         if( s->dist[ v ] == INFINITY ) search_relax( s, v, hops + 1.0f, u );
+      }
+   }
+
+   return s->n_touched;
+}
+
+
+//----------------------------------------------------------------------
+//                           Reordenamiento: 
+//----------------------------------------------------------------------
+
+/** Estrategias para renumerar los vértices con Graph_Reorder().
+ */
+typedef enum
+{
+   eGraphOrder_RCM,    ///< Cuthill-McKee inverso: vecinos con índices cercanos, banda angosta
+   eGraphOrder_BFS,    ///< orden de descubrimiento de un BFS
+   eGraphOrder_DEGREE  ///< de mayor a menor grado: los concentradores quedan juntos al inicio
+} eGraphOrder;
+
+static int cmp_uint64( const void* a, const void* b )
+{
+   uint64_t x = *(const uint64_t*) a;
+   uint64_t y = *(const uint64_t*) b;
+   return ( x > y ) - ( x < y );
+}
+
+// grado sin considerar la dirección de las aristas
+static inline int total_degree( const CSR* out, const CSR* in, int v )
+{
+   return csr_degree( out, v ) + ( in != out ? csr_degree( in, v ) : 0 );
+}
+
+// escribe en |order| los vértices en orden BFS (sin considerar la dirección), empezando cada
+// componente en el vértice no visitado de menor grado. Si |by_degree| es true, los vecinos de
+// cada vértice se visitan de menor a mayor grado (Cuthill-McKee).
+static bool bfs_order( const CSR* out, const CSR* in, int order[], bool by_degree )
+{
+   int n = out->n;
+
+   char* seen = (char*) calloc( n, 1 );
+   uint64_t* keys = (uint64_t*) malloc( n * sizeof( uint64_t ) );
+   uint64_t* buf = (uint64_t*) malloc( ( out->m + in->m + 1 ) * sizeof( uint64_t ) );
+
+   bool ok = seen && keys && buf;
+
+   if( ok )
+   {
+      // vértices de arranque candidatos, de menor a mayor grado
+      for( int v = 0; v < n; ++v ) keys[ v ] = (uint64_t) total_degree( out, in, v ) << 32 | (uint32_t) v;
+      qsort( keys, n, sizeof( uint64_t ), cmp_uint64 );
+
+      int tail = 0;
+      for( int r = 0; r < n; ++r )
+      {
+         int root = (int) (uint32_t) keys[ r ];
+         if( seen[ root ] ) continue;
+
+         seen[ root ] = 1;
+         int head = tail;
+         order[ tail++ ] = root;
+
+         while( head < tail )
+         {
+            int u = order[ head++ ];
+            int count = 0;
+
+            const CSR* lists[ 2 ] = { out, in };
+            for( int l = 0; l < ( in != out ? 2 : 1 ); ++l )
+            {
+               for( int e = lists[ l ]->start[ u ]; e < lists[ l ]->start[ u + 1 ]; ++e )
+               {
+                  int v = lists[ l ]->adj[ e ].index;
+                  if( !seen[ v ] )
+                  {
+                     seen[ v ] = 1;
+                     buf[ count++ ] = (uint64_t) ( by_degree ? total_degree( out, in, v ) : 0 ) << 32 | (uint32_t) v;
+                  }
+               }
+            }
+
+            if( by_degree ) qsort( buf, count, sizeof( uint64_t ), cmp_uint64 );
+            for( int k = 0; k < count; ++k ) order[ tail++ ] = (int) (uint32_t) buf[ k ];
+         }
+      }
+   }
+
+   free( seen );
+   free( keys );
+   free( buf );
+
+   return ok;
+}
+
+/**
+ * @brief Renumera los vértices del grafo para mejorar la localidad en memoria.
+ *
+ * Los índices de los vértices siguen el orden de inserción, así que los vecinos de un vértice
+ * suelen quedar dispersos en memoria. Esta función permuta el arreglo de vértices (con toda su
+ * información) y actualiza los índices en las listas de vecinos y los predecesores, de modo
+ * que los recorridos posteriores tocan menos líneas de caché. Las llaves de los vértices no
+ * cambian, así que las funciones que reciben el dato siguen funcionando igual; los índices
+ * guardados por el cliente se traducen con |perm|.
+ *
+ * @param g        El grafo.
+ * @param strategy La estrategia de renumeración.
+ * @param perm     Si no es NULL, arreglo de Graph_GetLen() elementos donde se escribe el nuevo
+ *                 índice de cada vértice: perm[ índice anterior ] = índice nuevo.
+ *
+ * @return false si no hubo memoria (el grafo queda sin cambios); true en caso contrario.
+ */
+bool Graph_Reorder( Graph* g, eGraphOrder strategy, int perm[] )
+{
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+   if( !out || !in ) return false;
+
+   int n = g->len;
+
+   int* order = (int*) malloc( n * sizeof( int ) );   // order[ nuevo ] = anterior
+   int* map = (int*) malloc( n * sizeof( int ) );     // map[ anterior ] = nuevo
+   Vertex* vertices = (Vertex*) calloc( g->size, sizeof( Vertex ) );
+
+   bool ok = order && map && vertices;
+
+   if( ok )
+   {
+      switch( strategy )
+      {
+         case eGraphOrder_RCM:
+            ok = bfs_order( out, in, order, true );
+            for( int i = 0; ok && i < n / 2; ++i )
+            {
+               int tmp = order[ i ];
+               order[ i ] = order[ n - 1 - i ];
+               order[ n - 1 - i ] = tmp;
+            }
+            break;
+
+         case eGraphOrder_BFS:
+            ok = bfs_order( out, in, order, false );
+            break;
+
+         case eGraphOrder_DEGREE:
+         {
+            uint64_t* keys = (uint64_t*) malloc( n * sizeof( uint64_t ) );
+            ok = keys != NULL;
+            if( ok )
+            {
+               // la llave invierte el grado para ordenar de mayor a menor, y desempata por índice
+               for( int v = 0; v < n; ++v )
+               {
+                  keys[ v ] = (uint64_t) ( INT_MAX - total_degree( out, in, v ) ) << 32 | (uint32_t) v;
+               }
+               qsort( keys, n, sizeof( uint64_t ), cmp_uint64 );
+               for( int k = 0; k < n; ++k ) order[ k ] = (int) (uint32_t) keys[ k ];
+               free( keys );
+            }
+            break;
+         }
+      }
+   }
+
+   if( ok )
+   {
+      for( int k = 0; k < n; ++k ) map[ order[ k ] ] = k;
+
+      for( int k = 0; k < n; ++k )
+      {
+         Vertex* v = &vertices[ k ];
+         *v = g->vertices[ order[ k ] ];
+
+         if( v->neighbors )
+         {
+            for( Node* it = v->neighbors->first; it; it = it->next ) it->data.index = map[ it->data.index ];
+         }
+         if( v->predecessor >= 0 ) v->predecessor = map[ v->predecessor ];
+         v->in_cursor = v->in_end = NULL;
+      }
+
+      free( g->vertices );
+      g->vertices = vertices;
+      vertices = NULL;
+
+      if( g->keys )
+      {
+         memset( g->keys, 0, ( g->keys_mask + 1 ) * sizeof( int ) );
+         for( int k = 0; k < n; ++k ) key_index_add( g, k );
+      }
+
+      for( int k = 0; k < IATA_CODES; ++k )
+      {
+         if( g->iata[ k ] != 0 ) g->iata[ k ] = map[ g->iata[ k ] - 1 ] + 1;
+      }
+
+      invalidate( g );
+
+      if( perm ) memcpy( perm, map, n * sizeof( int ) );
+   }
+
+   free( order );
+   free( map );
+   free( vertices );
+
+   return ok;
+}
+
+
+//----------------------------------------------------------------------
+//                           Adyacencia comprimida: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Listas de adyacencia comprimidas, de sólo lectura.
+ *
+ * Los vecinos de cada vértice se guardan ordenados por índice. Cada vecino ocupa la diferencia
+ * con el anterior codificada como varint (1 byte si la diferencia es menor que 128, lo común
+ * luego de Graph_Reorder()) seguida de su peso cuantizado a 16 bits. El primer vecino se
+ * codifica relativo al índice del propio vértice. Se recorre con CompactCSR_Start() y
+ * CompactCSR_Next(), que decodifican sobre la marcha.
+ */
+typedef struct
+{
+   uint32_t* offset; ///< n + 1 desplazamientos (en bytes) dentro de |bytes|
+   uint8_t* bytes;   ///< flujo de vecinos codificados
+   float weight_min;   ///< peso mínimo; el peso cuantizado q representa weight_min + q * weight_scale
+   float weight_scale;
+   int n;            ///< número de vértices
+   int m;            ///< número de aristas
+} CompactCSR;
+
+/**
+ * @brief Cursor sobre los vecinos de un vértice en un CompactCSR.
+ */
+typedef struct
+{
+   const uint8_t* pos;
+   const uint8_t* end;
+   int prev;              ///< índice del último vecino decodificado (o del vértice, al inicio)
+   bool first;            ///< true si aún no se decodifica ningún vecino
+   float weight_min;
+   float weight_scale;
+} CompactCursor;
+
+static uint8_t* put_varint( uint8_t* p, uint32_t value )
+{
+   while( value >= 0x80 )
+   {
+      *p++ = (uint8_t) ( value | 0x80 );
+      value >>= 7;
+   }
+   *p++ = (uint8_t) value;
+   return p;
+}
+
+static inline uint32_t get_varint( const uint8_t** p )
+{
+   if( !( **p & 0x80 ) ) return *(*p)++;
+   // caso común: un solo byte
+
+   uint32_t value = 0;
+   int shift = 0;
+   uint8_t byte;
+   do
+   {
+      byte = *(*p)++;
+      value |= (uint32_t) ( byte & 0x7f ) << shift;
+      shift += 7;
+   } while( byte & 0x80 );
+   return value;
+}
+
+// zigzag: los enteros con signo pequeños (en valor absoluto) quedan como enteros sin signo pequeños
+static inline uint32_t zigzag( int x )
+{
+   return ( (uint32_t) x << 1 ) ^ (uint32_t) ( x >> 31 );
+}
+
+static inline int unzigzag( uint32_t x )
+{
+   return (int) ( x >> 1 ) ^ -(int) ( x & 1 );
+}
+
+/**
+ * @brief Construye una copia comprimida de las listas de adyacencia.
+ *
+ * Respecto a un arreglo de Data { int, float } por arista, cada arista ocupa de 3 a 4 bytes en
+ * lugar de 8, a cambio de decodificar al recorrer. Los pesos se redondean a 65536 niveles entre
+ * el mínimo y el máximo del grafo. La copia no cambia si después se modifica el grafo.
+ *
+ * @param g El grafo.
+ *
+ * @return La copia comprimida, o NULL si no hubo memoria. El cliente la debe liberar con
+ * CompactCSR_Delete().
+ */
+CompactCSR* Graph_Compact( Graph* g )
+{
+   const CSR* out = out_edges( g );
+   if( !out ) return NULL;
+
+   CompactCSR* c = (CompactCSR*) calloc( 1, sizeof( CompactCSR ) );
+   int max_degree = 0;
+   for( int v = 0; v < out->n; ++v ) if( csr_degree( out, v ) > max_degree ) max_degree = csr_degree( out, v );
+
+   Data* sorted = (Data*) malloc( ( max_degree > 0 ? max_degree : 1 ) * sizeof( Data ) );
+   uint8_t* buf = (uint8_t*) malloc( (size_t) out->m * 7 + 1 );
+   // peor caso por arista: 5 bytes de varint y 2 de peso
+
+   if( !c || !sorted || !buf ||
+       !( c->offset = (uint32_t*) malloc( ( out->n + 1 ) * sizeof( uint32_t ) ) ) )
+   {
+      free( c );
+      free( sorted );
+      free( buf );
+      return NULL;
+   }
+
+   float lo = INFINITY;
+   float hi = -INFINITY;
+   for( int e = 0; e < out->m; ++e )
+   {
+      if( out->adj[ e ].weight < lo ) lo = out->adj[ e ].weight;
+      if( out->adj[ e ].weight > hi ) hi = out->adj[ e ].weight;
+   }
+   if( out->m == 0 ) lo = hi = 0.0f;
+
+   c->n = out->n;
+   c->m = out->m;
+   c->weight_min = lo;
+   c->weight_scale = hi > lo ? ( hi - lo ) / 65535.0f : 0.0f;
+
+   uint8_t* p = buf;
+   for( int v = 0; v < out->n; ++v )
+   {
+      c->offset[ v ] = (uint32_t) ( p - buf );
+
+      int degree = csr_degree( out, v );
+      memcpy( sorted, &out->adj[ out->start[ v ] ], degree * sizeof( Data ) );
+      qsort( sorted, degree, sizeof( Data ), cmp_int );
+      // |index| es el primer campo de Data, así que cmp_int ordena por índice
+
+      int prev = v;
+      for( int k = 0; k < degree; ++k )
+      {
+         p = put_varint( p, k == 0 ? zigzag( sorted[ k ].index - v ) : (uint32_t) ( sorted[ k ].index - prev ) );
+         prev = sorted[ k ].index;
+
+         uint16_t q = c->weight_scale > 0.0f ?
+            (uint16_t) lrintf( ( sorted[ k ].weight - lo ) / c->weight_scale ) : 0;
+         *p++ = (uint8_t) q;
+         *p++ = (uint8_t) ( q >> 8 );
+      }
+   }
+   c->offset[ out->n ] = (uint32_t) ( p - buf );
+
+   c->bytes = (uint8_t*) realloc( buf, p - buf + 1 );
+   if( !c->bytes ) c->bytes = buf;
+
+   free( sorted );
+
+   return c;
+}
+
+/**
+ * @brief Libera una copia comprimida creada con Graph_Compact().
+ *
+ * @param p_compact Referencia a la copia; queda en NULL.
+ */
+void CompactCSR_Delete( CompactCSR** p_compact )
+{
+   assert( *p_compact );
+
+   free( (*p_compact)->offset );
+   free( (*p_compact)->bytes );
+   free( *p_compact );
+   *p_compact = NULL;
+}
+
+/**
+ * @brief Devuelve cuántos bytes ocupa una copia comprimida.
+ */
+size_t CompactCSR_Bytes( const CompactCSR* c )
+{
+   return sizeof( CompactCSR ) + ( c->n + 1 ) * sizeof( uint32_t ) + c->offset[ c->n ];
+}
+
+/**
+ * @brief Coloca a |cursor| al inicio de los vecinos del vértice con índice |vertex_idx|.
+ *
+ * Ejemplo
+ * @code
+   CompactCursor it;
+   Data d;
+   for( CompactCSR_Start( c, idx, &it ); CompactCSR_Next( &it, &d ); )
+   {
+      // d.index es el índice del vecino y d.weight el peso (aproximado) de la arista
+   }
+   @endcode
+ */
+void CompactCSR_Start( const CompactCSR* c, int vertex_idx, CompactCursor* cursor )
+{
+   assert( 0 <= vertex_idx && vertex_idx < c->n );
+
+   cursor->pos = &c->bytes[ c->offset[ vertex_idx ] ];
+   cursor->end = &c->bytes[ c->offset[ vertex_idx + 1 ] ];
+   cursor->prev = vertex_idx;
+   cursor->first = true;
+   cursor->weight_min = c->weight_min;
+   cursor->weight_scale = c->weight_scale;
+}
+
+/**
+ * @brief Decodifica el siguiente vecino.
+ *
+ * @param cursor El cursor.
+ * @param d      Aquí se escriben el índice del vecino y el peso de la arista.
+ *
+ * @return false si ya no hay más vecinos; true en caso contrario.
+ */
+bool CompactCSR_Next( CompactCursor* cursor, Data* d )
+{
+   if( cursor->pos == cursor->end ) return false;
+
+   uint32_t raw = get_varint( &cursor->pos );
+   cursor->prev += cursor->first ? unzigzag( raw ) : (int) raw;
+   cursor->first = false;
+
+   uint16_t q = (uint16_t) ( cursor->pos[ 0 ] | cursor->pos[ 1 ] << 8 );
+   cursor->pos += 2;
+
+   d->index = cursor->prev;
+   d->weight = cursor->weight_min + q * cursor->weight_scale;
+
+   return true;
+}
+
+//----------------------------------------------------------------------
+//                           Búsqueda por prefijo: 
+//----------------------------------------------------------------------
+
+/** Campos de Airport sobre los que se puede buscar con PrefixIndex_Search(). Se pueden combinar
+ * con el operador |.
+ */
+typedef enum
+{
+   eAirportField_IATA = 1,
+   eAirportField_CITY = 2,
+   eAirportField_NAME = 4,
+   eAirportField_ALL = 7,
+} eAirportField;
+
+// número de campos en eAirportField
+#define PREFIX_FIELDS 3
+
+typedef struct
+{
+   const char* key; ///< apunta dentro de PrefixIndex::text, desde el inicio de una palabra
+   int vertex;      ///< índice del vértice
+} PrefixEntry;
+
+/**
+ * @brief Índice para autocompletar aeropuertos por código IATA, ciudad o nombre.
+ *
+ * Por cada campo hay un arreglo ordenado de entradas, una por cada palabra del campo, que apunta
+ * al texto del campo desde esa palabra hasta el final (un arreglo de sufijos restringido a
+ * inicios de palabra). Así "GAU" encuentra "CHARLES DE GAULLE". Las búsquedas son dos búsquedas
+ * binarias por campo. El texto se guarda en mayúsculas (sólo ASCII) y las búsquedas no
+ * distinguen mayúsculas de minúsculas.
+ *
+ * El índice es una fotografía del grafo: no cambia si después se agregan vértices o se llama a
+ * Graph_Reorder().
+ */
+typedef struct
+{
+   char* text;                               ///< los campos normalizados, terminados en '\0'
+   PrefixEntry* entries[ PREFIX_FIELDS ];    ///< entradas ordenadas de cada campo
+   int len[ PREFIX_FIELDS ];                 ///< número de entradas de cada campo
+} PrefixIndex;
+
+static inline char upper_ascii( char c )
+{
+   return ( c >= 'a' && c <= 'z' ) ? c - 'a' + 'A' : c;
+}
+
+// los bytes de UTF-8 (>= 0x80) cuentan como letras para que "JUÁREZ" sea una sola palabra
+static inline bool is_word_char( char c )
+{
+   unsigned char u = (unsigned char) c;
+   return ( u >= 'A' && u <= 'Z' ) || ( u >= 'a' && u <= 'z' ) || ( u >= '0' && u <= '9' ) || u >= 0x80;
+}
+
+static int cmp_prefix_entry( const void* a, const void* b )
+{
+   const PrefixEntry* x = (const PrefixEntry*) a;
+   const PrefixEntry* y = (const PrefixEntry*) b;
+
+   int r = strcmp( x->key, y->key );
+   return r != 0 ? r : ( x->vertex > y->vertex ) - ( x->vertex < y->vertex );
+}
+
+// copia |src| en mayúsculas a partir de |dst|; agrega una entrada por cada inicio de palabra
+// si |entries| no es NULL. Devuelve el número de entradas (contadas o agregadas).
+static int prefix_add_field( char** dst, const char* src, int vertex, PrefixEntry* entries )
+{
+   char* start = *dst;
+   int count = 0;
+
+   for( int i = 0; src[ i ]; ++i )
+   {
+      start[ i ] = upper_ascii( src[ i ] );
+
+      if( is_word_char( src[ i ] ) && ( i == 0 || !is_word_char( src[ i - 1 ] ) ) )
+      {
+         if( entries ) entries[ count ] = (PrefixEntry){ &start[ i ], vertex };
+         ++count;
+      }
+   }
+   *dst = start + strlen( src ) + 1;
+   ( *dst )[ -1 ] = '\0';
+
+   return count;
+}
+
+// primera entrada cuya llave no es menor que |prefix| (comparando sólo |len| caracteres)
+static int prefix_lower_bound( const PrefixEntry* entries, int n, const char* prefix, size_t len )
+{
+   int lo = 0;
+   int hi = n;
+   while( lo < hi )
+   {
+      int mid = lo + ( hi - lo ) / 2;
+      if( strncmp( entries[ mid ].key, prefix, len ) < 0 ) lo = mid + 1;
+      else hi = mid;
+   }
+   return lo;
+}
+
+/**
+ * @brief Libera un índice creado con Graph_BuildPrefixIndex().
+ *
+ * @param p_index Referencia al índice; queda en NULL.
+ */
+void PrefixIndex_Delete( PrefixIndex** p_index )
+{
+   assert( *p_index );
+
+   for( int f = 0; f < PREFIX_FIELDS; ++f ) free( (*p_index)->entries[ f ] );
+   free( (*p_index)->text );
+   free( *p_index );
+   *p_index = NULL;
+}
+
+/**
+ * @brief Construye el índice de autocompletado de los aeropuertos del grafo.
+ *
+ * Toma O(L log L), con L el número total de palabras en los campos indexados.
+ *
+ * @param g El grafo.
+ *
+ * @return El índice, o NULL si no hubo memoria. El cliente lo debe liberar con
+ * PrefixIndex_Delete().
+ */
+PrefixIndex* Graph_BuildPrefixIndex( const Graph* g )
+{
+   PrefixIndex* index = (PrefixIndex*) calloc( 1, sizeof( PrefixIndex ) );
+   if( !index ) return NULL;
+
+   size_t bytes = 0;
+   for( int v = 0; v < g->len; ++v )
+   {
+      const AirportInfo* info = &g->vertices[ v ].airport_info;
+      bytes += strlen( info->iata_code ) + strlen( Graph_GetString( g, info->city ) ) +
+         strlen( Graph_GetString( g, info->name ) ) + 3;
+   }
+
+   index->text = (char*) malloc( bytes > 0 ? bytes : 1 );
+
+   // primera pasada: contar las palabras de cada campo
+   char* p = index->text;
+   for( int v = 0; index->text && v < g->len; ++v )
+   {
+      const AirportInfo* info = &g->vertices[ v ].airport_info;
+      index->len[ 0 ] += prefix_add_field( &p, info->iata_code, v, NULL );
+      index->len[ 1 ] += prefix_add_field( &p, Graph_GetString( g, info->city ), v, NULL );
+      index->len[ 2 ] += prefix_add_field( &p, Graph_GetString( g, info->name ), v, NULL );
+   }
+
+   bool ok = index->text != NULL;
+   for( int f = 0; f < PREFIX_FIELDS; ++f )
+   {
+      index->entries[ f ] = (PrefixEntry*) malloc( ( index->len[ f ] + 1 ) * sizeof( PrefixEntry ) );
+      ok = ok && index->entries[ f ];
+   }
+
+   if( !ok )
+   {
+      PrefixIndex_Delete( &index );
+      return NULL;
+   }
+
+   // segunda pasada: registrar las entradas (el texto se vuelve a escribir igual)
+   int len[ PREFIX_FIELDS ] = { 0 };
+   p = index->text;
+   for( int v = 0; v < g->len; ++v )
+   {
+      const AirportInfo* info = &g->vertices[ v ].airport_info;
+      len[ 0 ] += prefix_add_field( &p, info->iata_code, v, &index->entries[ 0 ][ len[ 0 ] ] );
+      len[ 1 ] += prefix_add_field( &p, Graph_GetString( g, info->city ), v, &index->entries[ 1 ][ len[ 1 ] ] );
+      len[ 2 ] += prefix_add_field( &p, Graph_GetString( g, info->name ), v, &index->entries[ 2 ][ len[ 2 ] ] );
+   }
+
+   for( int f = 0; f < PREFIX_FIELDS; ++f )
+   {
+      qsort( index->entries[ f ], index->len[ f ], sizeof( PrefixEntry ), cmp_prefix_entry );
+   }
+
+   return index;
+}
+
+/**
+ * @brief Busca los aeropuertos con alguna palabra que empiece con |prefix|.
+ *
+ * Los resultados se ordenan primero por campo (código IATA, luego ciudad, luego nombre) y
+ * dentro de cada campo alfabéticamente, así que una coincidencia exacta del código aparece
+ * primero. Cada aeropuerto aparece una sola vez.
+ *
+ * @param index  El índice.
+ * @param prefix El texto a buscar (sin distinguir mayúsculas de minúsculas en ASCII).
+ * @param fields Los campos donde buscar; combinación de eAirportField.
+ * @param out    Arreglo para los índices de los vértices encontrados.
+ * @param max    Capacidad de |out|.
+ *
+ * @return El número de aeropuertos escritos en |out| (a lo más |max|).
+ */
+int PrefixIndex_Search( const PrefixIndex* index, const char* prefix, int fields, int out[], int max )
+{
+   char key[ 65 ];
+   size_t len = 0;
+   for( ; prefix[ len ] && len < sizeof( key ) - 1; ++len ) key[ len ] = upper_ascii( prefix[ len ] );
+   key[ len ] = '\0';
+
+   if( len == 0 ) return 0;
+
+   int found = 0;
+   for( int f = 0; f < PREFIX_FIELDS && found < max; ++f )
+   {
+      if( !( fields & ( 1 << f ) ) ) continue;
+
+      const PrefixEntry* entries = index->entries[ f ];
+      for( int k = prefix_lower_bound( entries, index->len[ f ], key, len );
+           k < index->len[ f ] && found < max && strncmp( entries[ k ].key, key, len ) == 0; ++k )
+      {
+         bool repeated = false;
+         for( int j = 0; j < found && !repeated; ++j ) repeated = out[ j ] == entries[ k ].vertex;
+         // |max| es pequeño (lo que cabe en una lista de sugerencias)
+
+         if( !repeated ) out[ found++ ] = entries[ k ].vertex;
+      }
+   }
+
+   return found;
+}
+
+//----------------------------------------------------------------------
+//                           Índice espacial: 
+//----------------------------------------------------------------------
+
+// radio medio de la Tierra, en km
+#define EARTH_RADIUS_KM 6371.0
+
+// M_PI no es parte de C estándar; <math.h> sólo lo define con extensiones POSIX o GNU
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct
+{
+   float x, y, z; ///< posición en la esfera unitaria
+   int vertex;    ///< índice del vértice
+} GeoPoint;
+
+/**
+ * @brief Índice espacial estático (árbol k-d) sobre las coordenadas de los aeropuertos.
+ *
+ * Cada aeropuerto se guarda como un punto sobre la esfera unitaria en 3D, así que la distancia
+ * en línea recta entre dos puntos crece con la distancia sobre la superficie y no hay casos
+ * especiales en los polos ni en el meridiano 180. El árbol es implícito: el nodo del rango
+ * [lo, hi) es el punto en la posición (lo + hi) / 2, que es la mediana del rango en la
+ * coordenada depth % 3; los subárboles son las dos mitades.
+ *
+ * El índice es una fotografía del grafo: no cambia si después se agregan vértices o se llama a
+ * Graph_Reorder().
+ */
+typedef struct
+{
+   GeoPoint* points; ///< los puntos en el orden del árbol
+   int n;            ///< número de puntos
+} GeoIndex;
+
+static inline float geo_coord( const GeoPoint* p, int dim )
+{
+   return dim == 0 ? p->x : dim == 1 ? p->y : p->z;
+}
+
+static GeoPoint geo_point( float latitude, float longitude, int vertex )
+{
+   double lat = latitude * M_PI / 180.0;
+   double lon = longitude * M_PI / 180.0;
+
+   return (GeoPoint){ (float) ( cos( lat ) * cos( lon ) ), (float) ( cos( lat ) * sin( lon ) ),
+                      (float) sin( lat ), vertex };
+}
+
+static inline float geo_chord2( const GeoPoint* a, const GeoPoint* b )
+{
+   float dx = a->x - b->x;
+   float dy = a->y - b->y;
+   float dz = a->z - b->z;
+   return dx * dx + dy * dy + dz * dz;
+}
+
+// distancia sobre la superficie (en km) correspondiente a una cuerda al cuadrado; es la misma
+// que da la fórmula del haversine
+static inline float geo_km( float chord2 )
+{
+   double half = sqrt( chord2 ) / 2.0;
+   return (float) ( 2.0 * EARTH_RADIUS_KM * asin( half < 1.0 ? half : 1.0 ) );
+}
+
+// deja en |points[ k ]| el punto que quedaría ahí si el rango [lo, hi) estuviera ordenado por
+// la coordenada |dim|, con los menores antes y los mayores después (quickselect)
+static void geo_select( GeoPoint points[], int lo, int hi, int k, int dim )
+{
+   while( hi - lo > 1 )
+   {
+      int mid = lo + ( hi - lo ) / 2;
+      float a = geo_coord( &points[ lo ], dim );
+      float b = geo_coord( &points[ mid ], dim );
+      float c = geo_coord( &points[ hi - 1 ], dim );
+      float pivot = a < b ? ( b < c ? b : ( a < c ? c : a ) ) : ( a < c ? a : ( b < c ? c : b ) );
+      // mediana de tres
+
+      int i = lo;
+      int j = hi - 1;
+      while( i <= j )
+      {
+         while( geo_coord( &points[ i ], dim ) < pivot ) ++i;
+         while( geo_coord( &points[ j ], dim ) > pivot ) --j;
+         if( i <= j )
+         {
+            GeoPoint tmp = points[ i ];
+            points[ i++ ] = points[ j ];
+            points[ j-- ] = tmp;
+         }
+      }
+
+      if( k <= j ) hi = j + 1;
+      else if( k >= i ) lo = i;
+      else return;
+   }
+}
+
+static void geo_build( GeoPoint points[], int lo, int hi, int depth )
+{
+   while( hi - lo > 1 )
+   {
+      int mid = lo + ( hi - lo ) / 2;
+      geo_select( points, lo, hi, mid, depth % 3 );
+
+      geo_build( points, lo, mid, depth + 1 );
+      lo = mid + 1;
+      ++depth;
+   }
+}
+
+// agrega a |out| los puntos del rango [lo, hi) a una cuerda al cuadrado no mayor que |limit2|
+static void geo_within( const GeoPoint points[], int lo, int hi, int depth, const GeoPoint* q,
+                        float limit2, Data out[], int* count )
+{
+   while( hi > lo )
+   {
+      int mid = lo + ( hi - lo ) / 2;
+      const GeoPoint* p = &points[ mid ];
+
+      float d2 = geo_chord2( p, q );
+      if( d2 <= limit2 )
+      {
+         out[ *count ].index = p->vertex;
+         out[ *count ].weight = d2;
+         ++*count;
+      }
+
+      float diff = geo_coord( q, depth % 3 ) - geo_coord( p, depth % 3 );
+      if( diff <= 0.0f || diff * diff <= limit2 ) geo_within( points, lo, mid, depth + 1, q, limit2, out, count );
+      if( diff < 0.0f && diff * diff > limit2 ) return;
+      // el lado derecho queda más lejos que el límite
+
+      lo = mid + 1;
+      ++depth;
+   }
+}
+
+// montículo de máximos sobre |best| (por weight) con los k puntos más cercanos vistos
+static void geo_sift_down( Data best[], int len, int i )
+{
+   for( ;; )
+   {
+      int largest = i;
+      int l = 2 * i + 1;
+      int r = l + 1;
+      if( l < len && best[ l ].weight > best[ largest ].weight ) largest = l;
+      if( r < len && best[ r ].weight > best[ largest ].weight ) largest = r;
+      if( largest == i ) return;
+
+      Data tmp = best[ i ];
+      best[ i ] = best[ largest ];
+      best[ largest ] = tmp;
+      i = largest;
+   }
+}
+
+static void geo_offer( Data best[], int k, int* len, int vertex, float d2 )
+{
+   if( *len < k )
+   {
+      int i = ( *len )++;
+      best[ i ] = (Data){ vertex, d2 };
+      while( i > 0 && best[ ( i - 1 ) / 2 ].weight < best[ i ].weight )
+      {
+         Data tmp = best[ i ];
+         best[ i ] = best[ ( i - 1 ) / 2 ];
+         best[ ( i - 1 ) / 2 ] = tmp;
+         i = ( i - 1 ) / 2;
+      }
+   }
+   else if( d2 < best[ 0 ].weight )
+   {
+      best[ 0 ] = (Data){ vertex, d2 };
+      geo_sift_down( best, *len, 0 );
+   }
+}
+
+static void geo_nearest( const GeoPoint points[], int lo, int hi, int depth, const GeoPoint* q,
+                         Data best[], int k, int* len )
+{
+   if( hi <= lo ) return;
+
+   int mid = lo + ( hi - lo ) / 2;
+   const GeoPoint* p = &points[ mid ];
+
+   geo_offer( best, k, len, p->vertex, geo_chord2( p, q ) );
+
+   float diff = geo_coord( q, depth % 3 ) - geo_coord( p, depth % 3 );
+   // primero el lado donde está |q|; el otro sólo si puede tener algo más cercano
+   if( diff <= 0.0f )
+   {
+      geo_nearest( points, lo, mid, depth + 1, q, best, k, len );
+      if( *len < k || diff * diff < best[ 0 ].weight ) geo_nearest( points, mid + 1, hi, depth + 1, q, best, k, len );
+   }
+   else
+   {
+      geo_nearest( points, mid + 1, hi, depth + 1, q, best, k, len );
+      if( *len < k || diff * diff < best[ 0 ].weight ) geo_nearest( points, lo, mid, depth + 1, q, best, k, len );
+   }
+}
+
+static int cmp_data_weight( const void* a, const void* b )
+{
+   float x = ( (const Data*) a )->weight;
+   float y = ( (const Data*) b )->weight;
+   if( x != y ) return ( x > y ) - ( x < y );
+
+   int i = ( (const Data*) a )->index;
+   int j = ( (const Data*) b )->index;
+   return ( i > j ) - ( i < j );
+}
+
+// ordena los resultados por distancia y cambia las cuerdas al cuadrado por kilómetros
+static void geo_finish( Data out[], int count )
+{
+   qsort( out, count, sizeof( Data ), cmp_data_weight );
+   for( int k = 0; k < count; ++k ) out[ k ].weight = geo_km( out[ k ].weight );
+}
+
+/**
+ * @brief Libera un índice creado con Graph_BuildGeoIndex().
+ *
+ * @param p_index Referencia al índice; queda en NULL.
+ */
+void GeoIndex_Delete( GeoIndex** p_index )
+{
+   assert( *p_index );
+
+   free( (*p_index)->points );
+   free( *p_index );
+   *p_index = NULL;
+}
+
+/**
+ * @brief Construye el índice espacial de los aeropuertos del grafo.
+ *
+ * Toma O(n log n). Los aeropuertos con coordenadas inválidas (NaN o infinitas) no se indexan.
+ *
+ * @param g El grafo.
+ *
+ * @return El índice, o NULL si no hubo memoria. El cliente lo debe liberar con
+ * GeoIndex_Delete().
+ */
+GeoIndex* Graph_BuildGeoIndex( const Graph* g )
+{
+   GeoIndex* index = (GeoIndex*) calloc( 1, sizeof( GeoIndex ) );
+   if( !index ) return NULL;
+
+   index->points = (GeoPoint*) malloc( ( g->len > 0 ? g->len : 1 ) * sizeof( GeoPoint ) );
+   if( !index->points )
+   {
+      GeoIndex_Delete( &index );
+      return NULL;
+   }
+
+   for( int v = 0; v < g->len; ++v )
+   {
+      const AirportInfo* info = &g->vertices[ v ].airport_info;
+      if( isfinite( info->latitude ) && isfinite( info->longitude ) )
+      {
+         index->points[ index->n++ ] = geo_point( info->latitude, info->longitude, v );
+      }
+   }
+
+   geo_build( index->points, 0, index->n, 0 );
+
+   return index;
+}
+
+/**
+ * @brief Busca los aeropuertos a no más de |radius_km| kilómetros (sobre la superficie de la
+ * Tierra) de un punto.
+ *
+ * @param index     El índice.
+ * @param latitude  Latitud del punto, en grados.
+ * @param longitude Longitud del punto, en grados.
+ * @param radius_km El radio de búsqueda, en km.
+ * @param out       Arreglo de tamaño Graph_GetLen(). Por cada aeropuerto encontrado se escriben
+ *                  su índice (para Graph_GetVertexByIndex()) y su distancia en km, del más
+ *                  cercano al más lejano.
+ *
+ * @return El número de aeropuertos encontrados.
+ */
+int GeoIndex_Within( const GeoIndex* index, float latitude, float longitude, float radius_km, Data out[] )
+{
+   if( radius_km < 0.0f ) return 0;
+
+   double half_angle = radius_km / ( 2.0 * EARTH_RADIUS_KM );
+   float limit2 = half_angle >= M_PI / 2.0 ? 4.0f : (float) ( 4.0 * sin( half_angle ) * sin( half_angle ) );
+   // cuerda que subtiende el radio, al cuadrado; 4 (el diámetro al cuadrado) abarca toda la esfera
+
+   limit2 *= 1.0f + 4.0f * FLT_EPSILON;
+   // margen para el redondeo de float; los que queden de más se quitan al final
+
+   GeoPoint q = geo_point( latitude, longitude, -1 );
+   int count = 0;
+   geo_within( index->points, 0, index->n, 0, &q, limit2, out, &count );
+   geo_finish( out, count );
+
+   while( count > 0 && out[ count - 1 ].weight > radius_km ) --count;
+
+   return count;
+}
+
+/**
+ * @brief Busca los |k| aeropuertos más cercanos a un punto.
+ *
+ * @param index     El índice.
+ * @param latitude  Latitud del punto, en grados.
+ * @param longitude Longitud del punto, en grados.
+ * @param k         Cuántos aeropuertos se quieren.
+ * @param out       Arreglo de tamaño |k|. Por cada aeropuerto encontrado se escriben su índice
+ *                  (para Graph_GetVertexByIndex()) y su distancia en km, del más cercano al más
+ *                  lejano.
+ *
+ * @return El número de aeropuertos encontrados (|k|, o menos si el índice tiene menos).
+ */
+int GeoIndex_Nearest( const GeoIndex* index, float latitude, float longitude, int k, Data out[] )
+{
+   if( k <= 0 ) return 0;
+
+   GeoPoint q = geo_point( latitude, longitude, -1 );
+   int count = 0;
+   geo_nearest( index->points, 0, index->n, 0, &q, out, k, &count );
+   geo_finish( out, count );
+
+   return count;
+}
+
+//----------------------------------------------------------------------
+//                           Construcción concurrente: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Buffer de aristas de un hilo. Se alinea a una línea de caché para que los hilos no
+ * compartan líneas al actualizar |len|.
+ */
+typedef struct
+{
+   Edge* edges; ///< aristas con índices (no llaves) de vértices
+   int len;
+   int cap;
+} __attribute__(( aligned( 64 ) )) EdgeBuffer;
+
+/**
+ * @brief Construcción concurrente de aristas.
+ *
+ * Cada hilo agrega aristas a su propio buffer con GraphBuilder_AddEdge() sin sincronizarse con
+ * los demás. Graph_EndBuild() las pasa al grafo en paralelo.
+ */
+typedef struct
+{
+   Graph* graph;
+   EdgeBuffer* buffers; ///< uno por hilo
+   int threads;
+} GraphBuilder;
+
+// una arista ya repartida a su vértice de origen; |seq| es su orden de llegada (buffer, posición)
+typedef struct
+{
+   uint64_t seq;
+   int index;
+   float weight;
+} BuildEntry;
+
+static int cmp_build_by_index( const void* a, const void* b )
+{
+   const BuildEntry* x = (const BuildEntry*) a;
+   const BuildEntry* y = (const BuildEntry*) b;
+   if( x->index != y->index ) return ( x->index > y->index ) - ( x->index < y->index );
+   return ( x->seq > y->seq ) - ( x->seq < y->seq );
+}
+
+static int cmp_build_by_seq( const void* a, const void* b )
+{
+   const BuildEntry* x = (const BuildEntry*) a;
+   const BuildEntry* y = (const BuildEntry*) b;
+   return ( x->seq > y->seq ) - ( x->seq < y->seq );
+}
+
+static void builder_free( GraphBuilder** p_builder )
+{
+   GraphBuilder* b = *p_builder;
+
+   for( int t = 0; t < b->threads; ++t ) free( b->buffers[ t ].edges );
+   free( b->buffers );
+   free( b );
+   *p_builder = NULL;
+}
+
+// arma en paralelo el CSR de salida luego de Graph_EndBuild(): de cada vértice, los vecinos que
+// ya tenía (|degree[ v ]| - |fresh[ v ]|, tomados de su lista) seguidos de los nuevos, que están
+// al inicio de su segmento en |entries|. Así no se recorren los nodos recién creados.
+static CSR* csr_after_build( const Graph* g, const int degree[], const int fresh[],
+                             const long start[], const BuildEntry entries[] )
+{
+   int n = g->len;
+
+   long m = 0;
+   for( int v = 0; v < n; ++v ) m += degree[ v ];
+   if( m > INT_MAX ) return NULL;
+
+   CSR* csr = csr_new( n, (int) m );
+   if( !csr ) return NULL;
+
+   for( int v = 0; v < n; ++v ) csr->start[ v + 1 ] = csr->start[ v ] + degree[ v ];
+
+   #pragma omp parallel for schedule( dynamic, 256 )
+   for( int v = 0; v < n; ++v )
+   {
+      Data* adj = &csr->adj[ csr->start[ v ] ];
+      int old = degree[ v ] - fresh[ v ];
+
+      Node* it = g->vertices[ v ].neighbors ? g->vertices[ v ].neighbors->first : NULL;
+      for( int k = 0; k < old; ++k, it = it->next ) adj[ k ] = it->data;
+
+      for( int k = 0; k < fresh[ v ]; ++k )
+      {
+         adj[ old + k ].index = entries[ start[ v ] + k ].index;
+         adj[ old + k ].weight = entries[ start[ v ] + k ].weight;
+      }
+   }
+
+   return csr;
+}
+
+/**
+ * @brief Inicia la construcción concurrente de aristas.
+ *
+ * Mientras la construcción esté abierta no se deben agregar vértices ni modificar el grafo de
+ * otra forma; sí se puede consultar.
+ *
+ * @param g       El grafo, con todos sus vértices ya agregados.
+ * @param threads Número de hilos que agregarán aristas; si es 0 o menor se usa el número de
+ *                hilos de OpenMP.
+ *
+ * @return El constructor, o NULL si no hubo memoria. Se termina con Graph_EndBuild().
+ */
+GraphBuilder* Graph_BeginBuild( Graph* g, int threads )
+{
+   if( threads <= 0 )
+   {
+#ifdef _OPENMP
+      threads = omp_get_max_threads();
+#else
+      threads = 1;
+#endif
+   }
+
+   GraphBuilder* b = (GraphBuilder*) malloc( sizeof( GraphBuilder ) );
+   EdgeBuffer* buffers = (EdgeBuffer*) aligned_alloc( 64, threads * sizeof( EdgeBuffer ) );
+   if( !b || !buffers )
+   {
+      free( b );
+      free( buffers );
+      return NULL;
+   }
+
+   for( int t = 0; t < threads; ++t ) buffers[ t ] = (EdgeBuffer){ NULL, 0, 0 };
+
+   b->graph = g;
+   b->buffers = buffers;
+   b->threads = threads;
+
+   return b;
+}
+
+/**
+ * @brief Agrega una arista con peso durante una construcción concurrente. Se puede llamar
+ * desde varios hilos a la vez siempre que cada uno use un |thread| distinto.
+ *
+ * Las llaves se resuelven aquí; la arista aparece en el grafo hasta Graph_EndBuild(). El
+ * resultado es el mismo que el de llamar Graph_AddWeightedEdge() con las aristas de cada buffer
+ * en orden, buffer por buffer.
+ *
+ * @param b      El constructor.
+ * @param thread Número de buffer, entre 0 y el número de hilos de Graph_BeginBuild() - 1.
+ * @param start  La llave del vértice de salida.
+ * @param finish La llave del vértice de llegada.
+ * @param weight El peso de la arista.
+ *
+ * @return false si alguno de los vértices no existe o si no hubo memoria; true en caso
+ * contrario.
+ */
+bool GraphBuilder_AddEdge( GraphBuilder* b, int thread, int start, int finish, float weight )
+{
+   assert( 0 <= thread && thread < b->threads );
+
+   int start_idx = find_key( b->graph, start );
+   int finish_idx = find_key( b->graph, finish );
+   if( start_idx == -1 || finish_idx == -1 ) return false;
+
+   EdgeBuffer* buf = &b->buffers[ thread ];
+   if( buf->len == buf->cap )
+   {
+      int cap = buf->cap > 0 ? 2 * buf->cap : 1024;
+      Edge* edges = (Edge*) realloc( buf->edges, cap * sizeof( Edge ) );
+      if( !edges ) return false;
+
+      buf->edges = edges;
+      buf->cap = cap;
+   }
+
+   buf->edges[ buf->len++ ] = (Edge){ start_idx, finish_idx, weight };
+
+   return true;
+}
+
+/**
+ * @brief Termina una construcción concurrente: pasa las aristas de todos los buffers a las
+ * listas de vecinos y deja listo el índice CSR.
+ *
+ * Las aristas se reparten por vértice de origen con una suma de prefijos; luego cada vértice,
+ * en paralelo, ordena las suyas, descarta las repetidas (gana la primera, como en
+ * Graph_AddWeightedEdge()) y las que ya estaban en su lista, y agrega el resto en orden de
+ * llegada.
+ *
+ * @param p_builder Referencia al constructor; se libera y queda en NULL aun si falla.
+ *
+ * @return El número de vecinos agregados a las listas (en un grafo no dirigido cada arista nueva
+ * cuenta dos veces), o -1 si no hubo memoria; en ese caso el grafo no cambia.
+ */
+long Graph_EndBuild( GraphBuilder** p_builder )
+{
+   assert( *p_builder );
+
+   GraphBuilder* b = *p_builder;
+   Graph* g = b->graph;
+   int n = g->len;
+   bool undirected = g->type == eGraphType_UNDIRECTED;
+
+   long total = 0;
+   for( int t = 0; t < b->threads; ++t ) total += b->buffers[ t ].len;
+   if( undirected ) total *= 2;
+
+   int* degree = (int*) calloc( n + 1, sizeof( int ) );
+   int* fresh = (int*) calloc( n + 1, sizeof( int ) );
+   long* start = (long*) malloc( ( n + 1 ) * sizeof( long ) );
+   BuildEntry* entries = (BuildEntry*) malloc( ( total > 0 ? total : 1 ) * sizeof( BuildEntry ) );
+
+   if( !degree || !fresh || !start || !entries )
+   {
+      free( degree );
+      free( fresh );
+      free( start );
+      free( entries );
+      builder_free( p_builder );
+      return -1;
+   }
+
+   // 1. cuántas aristas salen de cada vértice
+   for( int t = 0; t < b->threads; ++t )
+   {
+      const EdgeBuffer* buf = &b->buffers[ t ];
+
+      #pragma omp parallel for schedule( static )
+      for( int k = 0; k < buf->len; ++k )
+      {
+         __atomic_fetch_add( &degree[ buf->edges[ k ].start ], 1, __ATOMIC_RELAXED );
+         if( undirected ) __atomic_fetch_add( &degree[ buf->edges[ k ].finish ], 1, __ATOMIC_RELAXED );
+      }
+   }
+
+   start[ 0 ] = 0;
+   for( int v = 0; v < n; ++v )
+   {
+      start[ v + 1 ] = start[ v ] + degree[ v ];
+      degree[ v ] = 0;
+   }
+
+   // 2. repartirlas: el segmento [start[v], start[v + 1]) tiene las que salen de v
+   for( int t = 0; t < b->threads; ++t )
+   {
+      const EdgeBuffer* buf = &b->buffers[ t ];
+
+      #pragma omp parallel for schedule( static )
+      for( int k = 0; k < buf->len; ++k )
+      {
+         Edge e = buf->edges[ k ];
+         uint64_t seq = (uint64_t) t << 32 | (uint32_t) k;
+
+         long pos = start[ e.start ] + __atomic_fetch_add( &degree[ e.start ], 1, __ATOMIC_RELAXED );
+         entries[ pos ] = (BuildEntry){ seq, e.finish, e.weight };
+
+         if( undirected )
+         {
+            pos = start[ e.finish ] + __atomic_fetch_add( &degree[ e.finish ], 1, __ATOMIC_RELAXED );
+            entries[ pos ] = (BuildEntry){ seq, e.start, e.weight };
+         }
+      }
+   }
+
+   // 3. las listas que hagan falta se crean antes de tocar ninguna, para que si no hay memoria el
+   // grafo no cambie; |fresh| marca las creadas aquí por si hay que deshacerlo
+   bool ok = true;
+   for( int v = 0; v < n && ok; ++v )
+   {
+      if( start[ v + 1 ] > start[ v ] && !g->vertices[ v ].neighbors )
+      {
+         if( ( g->vertices[ v ].neighbors = List_New() ) ) fresh[ v ] = 1;
+         else ok = false;
+      }
+   }
+
+   // 4. por vértice: quitar repetidas y agregarlas a la lista; |degree| queda con la longitud de
+   // cada lista y |fresh| con cuántos vecinos nuevos tiene (al inicio de su segmento)
+   long added = 0;
+
+   #pragma omp parallel reduction( +:added )
+   {
+      int* mark = ok ? (int*) calloc( n, sizeof( int ) ) : NULL;
+      // mark[ u ] == v + 1 si u ya es vecino de v
+
+      if( !mark ) __atomic_store_n( &ok, false, __ATOMIC_RELAXED );
+
+      #pragma omp barrier
+      // o todos los hilos tienen |mark| o ninguno toca el grafo
+
+      if( __atomic_load_n( &ok, __ATOMIC_RELAXED ) )
+      {
+         #pragma omp for schedule( dynamic, 64 )
+         for( int v = 0; v < n; ++v )
+         {
+            Vertex* vertex = &g->vertices[ v ];
+            BuildEntry* seg = &entries[ start[ v ] ];
+            int len = (int) ( start[ v + 1 ] - start[ v ] );
+            int list_len = 0;
+
+            if( vertex->neighbors )
+            {
+               for( Node* it = vertex->neighbors->first; it; it = it->next )
+               {
+                  mark[ it->data.index ] = v + 1;
+                  ++list_len;
+               }
+            }
+
+            qsort( seg, len, sizeof( BuildEntry ), cmp_build_by_index );
+
+            int kept = 0;
+            for( int k = 0; k < len; ++k )
+            {
+               if( mark[ seg[ k ].index ] == v + 1 ) continue;
+               mark[ seg[ k ].index ] = v + 1;
+               seg[ kept++ ] = seg[ k ];
+            }
+
+            qsort( seg, kept, sizeof( BuildEntry ), cmp_build_by_seq );
+
+            for( int k = 0; k < kept; ++k )
+            {
+               List_Push_back( vertex->neighbors, seg[ k ].index, seg[ k ].weight );
+               ++list_len;
+               ++added;
+            }
+
+            degree[ v ] = list_len;
+            fresh[ v ] = kept;
+         }
+      }
+
+      free( mark );
+   }
+
+   if( ok )
+   {
+      invalidate( g );
+      g->out = csr_after_build( g, degree, fresh, start, entries );
+      // si no hay memoria queda en NULL y out_edges() lo construirá después
+   }
+   else
+   {
+      for( int v = 0; v < n; ++v )
+      {
+         if( fresh[ v ] ) List_Delete( &g->vertices[ v ].neighbors );
+      }
+   }
+
+   free( degree );
+   free( fresh );
+   free( start );
+   free( entries );
+   builder_free( p_builder );
+
+   return ok ? added : -1;
+}
+
+//----------------------------------------------------------------------
+//                           Versiones (lectura sin bloqueo): 
+//----------------------------------------------------------------------
+
+// vértices por página de una versión
+#define SNAPSHOT_PAGE 256
+
+typedef struct
+{
+   const Data* adj[ SNAPSHOT_PAGE ]; ///< vecinos de cada vértice de la página (segmento contiguo)
+   int degree[ SNAPSHOT_PAGE ];
+} SnapshotPage;
+
+/**
+ * @brief Una versión inmutable de las listas de adyacencia.
+ *
+ * Los vecinos de cada vértice están en un segmento contiguo. Una versión nueva comparte con la
+ * anterior todas las páginas y segmentos que no cambiaron.
+ */
+typedef struct
+{
+   uint64_t version;
+   int n;                ///< número de vértices
+   SnapshotPage** pages; ///< ( n + SNAPSHOT_PAGE - 1 ) / SNAPSHOT_PAGE páginas
+} Snapshot;
+
+// memoria que dejó de usarse al publicar la versión |version| + 1; se libera cuando ningún
+// lector tiene fija una versión menor o igual que |version|
+typedef struct Retired
+{
+   uint64_t version;
+   Snapshot* snapshot; ///< la versión reemplazada
+   void** ptrs;        ///< páginas y segmentos reemplazados
+   int len;
+   struct Retired* next;
+} Retired;
+
+typedef struct
+{
+   uint64_t version; ///< versión fijada por el lector; 0 si no tiene ninguna
+} __attribute__(( aligned( 64 ) )) ReaderSlot;
+
+/**
+ * @brief Grafo con versiones: los escritores publican versiones nuevas mientras los lectores
+ * consultan, sin que ninguno espere al otro.
+ *
+ * Un lector fija la versión actual con VersionedGraph_Pin() (dos lecturas y una escritura
+ * atómicas, sin candados) y la consulta hasta VersionedGraph_Unpin(); nada de lo que ve cambia
+ * mientras tanto. Un escritor copia sólo las páginas y segmentos de los vértices que modifica,
+ * publica la versión nueva con una escritura atómica y libera la memoria de versiones viejas
+ * que ya ningún lector tiene fijas (reclamación por épocas).
+ *
+ * El conjunto de vértices es el del grafo original, que debe vivir más que este objeto y no
+ * debe cambiar sus vértices (agregar o reordenar) mientras tanto.
+ */
+typedef struct
+{
+   Graph* graph;        ///< para resolver llaves y el tipo del grafo
+   Snapshot* current;   ///< versión publicada
+   uint64_t version;    ///< número de la versión publicada; se actualiza después de |current|
+   ReaderSlot* readers;
+   int n_readers;
+
+   pthread_mutex_t lock; ///< serializa a los escritores, que lo tienen mientras copian y reservan
+   Retired* retired;    ///< de la más vieja a la más nueva
+   Retired* retired_last;
+   Data* base;          ///< bloque con los segmentos de la primera versión; se libera al final
+   int base_len;
+   int* mark;           ///< marcas del escritor para descartar vecinos repetidos
+   int mark_stamp;
+} VersionedGraph;
+
+// una arista de un lote, ya con índices; |seq| conserva el orden del lote
+typedef struct
+{
+   int start;
+   int finish;
+   float weight;
+   int seq;
+} BatchEdge;
+
+static int cmp_batch_edge( const void* a, const void* b )
+{
+   const BatchEdge* x = (const BatchEdge*) a;
+   const BatchEdge* y = (const BatchEdge*) b;
+   if( x->start != y->start ) return ( x->start > y->start ) - ( x->start < y->start );
+   return ( x->seq > y->seq ) - ( x->seq < y->seq );
+}
+
+static void snapshot_free( Snapshot* s )
+{
+   free( s->pages );
+   free( s );
+}
+
+static bool retired_push( Retired* r, void* ptr, int* cap )
+{
+   if( r->len == *cap )
+   {
+      *cap = *cap > 0 ? 2 * *cap : 64;
+      void** ptrs = (void**) realloc( r->ptrs, *cap * sizeof( void* ) );
+      if( !ptrs ) return false;
+      r->ptrs = ptrs;
+   }
+   r->ptrs[ r->len++ ] = ptr;
+   return true;
+}
+
+// libera lo que ya ningún lector puede estar viendo
+static void versioned_reclaim( VersionedGraph* vg )
+{
+   uint64_t min_pinned = UINT64_MAX;
+   for( int r = 0; r < vg->n_readers; ++r )
+   {
+      uint64_t v = __atomic_load_n( &vg->readers[ r ].version, __ATOMIC_SEQ_CST );
+      if( v != 0 && v < min_pinned ) min_pinned = v;
+   }
+
+   while( vg->retired && vg->retired->version < min_pinned )
+   {
+      Retired* r = vg->retired;
+      vg->retired = r->next;
+
+      for( int k = 0; k < r->len; ++k ) free( r->ptrs[ k ] );
+      free( r->ptrs );
+      snapshot_free( r->snapshot );
+      free( r );
+   }
+   if( !vg->retired ) vg->retired_last = NULL;
+}
+
+static inline bool in_base( const VersionedGraph* vg, const Data* seg )
+{
+   return seg >= vg->base && seg < vg->base + vg->base_len;
+}
+
+/**
+ * @brief Crea un grafo con versiones cuya primera versión son las aristas actuales de |g|.
+ *
+ * @param g         El grafo.
+ * @param n_readers Número de lectores concurrentes (cada uno con su número, de 0 a n_readers - 1).
+ *
+ * @return El grafo con versiones, o NULL si no hubo memoria. El cliente lo debe liberar con
+ * VersionedGraph_Delete().
+ */
+VersionedGraph* Graph_NewVersioned( Graph* g, int n_readers )
+{
+   assert( n_readers > 0 );
+
+   const CSR* out = out_edges( g );
+   if( !out ) return NULL;
+
+   int n = g->len;
+   int n_pages = ( n + SNAPSHOT_PAGE - 1 ) / SNAPSHOT_PAGE;
+   int base_len = out->m > 0 ? out->m : 1;
+   // al menos un elemento, para que los segmentos vacíos (que apuntan a |base|) caigan en él
+
+   VersionedGraph* vg = (VersionedGraph*) calloc( 1, sizeof( VersionedGraph ) );
+   Snapshot* s = (Snapshot*) malloc( sizeof( Snapshot ) );
+   SnapshotPage** pages = (SnapshotPage**) calloc( n_pages > 0 ? n_pages : 1, sizeof( SnapshotPage* ) );
+   ReaderSlot* readers = (ReaderSlot*) aligned_alloc( 64, n_readers * sizeof( ReaderSlot ) );
+   Data* base = (Data*) malloc( base_len * sizeof( Data ) );
+   int* mark = (int*) calloc( n > 0 ? n : 1, sizeof( int ) );
+
+   bool ok = vg && s && pages && readers && base && mark;
+   for( int p = 0; ok && p < n_pages; ++p )
+   {
+      ok = ( pages[ p ] = (SnapshotPage*) calloc( 1, sizeof( SnapshotPage ) ) ) != NULL;
+   }
+   ok = ok && pthread_mutex_init( &vg->lock, NULL ) == 0;
+
+   if( !ok )
+   {
+      for( int p = 0; pages && p < n_pages; ++p ) free( pages[ p ] );
+      free( vg );
+      free( s );
+      free( pages );
+      free( readers );
+      free( base );
+      free( mark );
+      return NULL;
+   }
+
+   memcpy( base, out->adj, out->m * sizeof( Data ) );
+
+   for( int v = 0; v < n; ++v )
+   {
+      pages[ v / SNAPSHOT_PAGE ]->adj[ v % SNAPSHOT_PAGE ] = csr_degree( out, v ) > 0 ? &base[ out->start[ v ] ] : base;
+      // así todo segmento de la primera versión cae dentro de [base, base + base_len)
+      pages[ v / SNAPSHOT_PAGE ]->degree[ v % SNAPSHOT_PAGE ] = csr_degree( out, v );
+   }
+   for( int r = 0; r < n_readers; ++r ) readers[ r ].version = 0;
+
+   s->version = 1;
+   s->n = n;
+   s->pages = pages;
+
+   vg->graph = g;
+   vg->current = s;
+   vg->version = 1;
+   vg->readers = readers;
+   vg->n_readers = n_readers;
+   vg->base = base;
+   vg->base_len = base_len;
+   vg->mark = mark;
+
+   return vg;
+}
+
+/**
+ * @brief Libera un grafo con versiones. Ningún lector debe tener una versión fija.
+ *
+ * @param p_vg Referencia al grafo con versiones; queda en NULL.
+ */
+void VersionedGraph_Delete( VersionedGraph** p_vg )
+{
+   assert( *p_vg );
+
+   VersionedGraph* vg = *p_vg;
+
+   for( int r = 0; r < vg->n_readers; ++r ) vg->readers[ r ].version = 0;
+   versioned_reclaim( vg );
+   // sin lectores se liberan todas las versiones retiradas
+
+   Snapshot* s = vg->current;
+   for( int v = 0; v < s->n; ++v )
+   {
+      const Data* seg = s->pages[ v / SNAPSHOT_PAGE ]->adj[ v % SNAPSHOT_PAGE ];
+      if( !in_base( vg, seg ) ) free( (void*) seg );
+   }
+   for( int p = 0; p < ( s->n + SNAPSHOT_PAGE - 1 ) / SNAPSHOT_PAGE; ++p ) free( s->pages[ p ] );
+   snapshot_free( s );
+
+   pthread_mutex_destroy( &vg->lock );
+   free( vg->readers );
+   free( vg->base );
+   free( vg->mark );
+   free( vg );
+   *p_vg = NULL;
+}
+
+/**
+ * @brief Agrega un lote de aristas con peso como una sola versión nueva y la publica.
+ *
+ * El resultado es el mismo que el de llamar Graph_AddWeightedEdge() con cada arista del lote
+ * en orden (las aristas ya existentes no cambian), pero el grafo original no se modifica. Sólo
+ * se copian las páginas y los segmentos de los vértices de salida de las aristas. Se puede
+ * llamar desde varios hilos; los escritores se turnan.
+ *
+ * @param vg    El grafo con versiones.
+ * @param edges Las aristas, con las llaves de sus vértices.
+ * @param len   Número de aristas.
+ *
+ * @return El número de vecinos agregados (en un grafo no dirigido cada arista nueva cuenta
+ * dos veces), o -1 si no hubo memoria; en ese caso no se publica nada. Si no se agrega nada
+ * tampoco se publica una versión nueva.
+ */
+int VersionedGraph_AddWeightedEdges( VersionedGraph* vg, const Edge edges[], int len )
+{
+   bool undirected = vg->graph->type == eGraphType_UNDIRECTED;
+
+   BatchEdge* batch = (BatchEdge*) malloc( ( 2 * len > 0 ? 2 * len : 1 ) * sizeof( BatchEdge ) );
+   if( !batch ) return -1;
+
+   int b = 0;
+   for( int k = 0; k < len; ++k )
+   {
+      int u = find_key( vg->graph, edges[ k ].start );
+      int v = find_key( vg->graph, edges[ k ].finish );
+      if( u == -1 || v == -1 ) continue;
+
+      batch[ b++ ] = (BatchEdge){ u, v, edges[ k ].weight, 2 * k };
+      if( undirected ) batch[ b++ ] = (BatchEdge){ v, u, edges[ k ].weight, 2 * k + 1 };
+   }
+   qsort( batch, b, sizeof( BatchEdge ), cmp_batch_edge );
+
+   pthread_mutex_lock( &vg->lock );
+   // los escritores se turnan (y esperan dormidos); los lectores nunca toman este candado
+
+   Snapshot* cur = vg->current;
+   int n_pages = ( cur->n + SNAPSHOT_PAGE - 1 ) / SNAPSHOT_PAGE;
+
+   Snapshot* next = (Snapshot*) malloc( sizeof( Snapshot ) );
+   SnapshotPage** pages = (SnapshotPage**) malloc( ( n_pages > 0 ? n_pages : 1 ) * sizeof( SnapshotPage* ) );
+   Retired* retired = (Retired*) calloc( 1, sizeof( Retired ) );
+   void** created = (void**) malloc( ( 2 * b > 0 ? 2 * b : 1 ) * sizeof( void* ) );
+   // lo que se crea para esta versión, por si hay que deshacerla
+   int n_created = 0;
+   int cap = 0;
+   int added = 0;
+   bool ok = next && pages && retired && created;
+
+   if( ok ) memcpy( pages, cur->pages, n_pages * sizeof( SnapshotPage* ) );
+
+   for( int i = 0; ok && i < b; )
+   {
+      int u = batch[ i ].start;
+      int group_end = i;
+      while( group_end < b && batch[ group_end ].start == u ) ++group_end;
+
+      SnapshotPage* page = pages[ u / SNAPSHOT_PAGE ];
+      const Data* old_adj = page->adj[ u % SNAPSHOT_PAGE ];
+      int degree = page->degree[ u % SNAPSHOT_PAGE ];
+
+      // descartar los vecinos repetidos: los que ya tenía y los repetidos dentro del lote
+      if( vg->mark_stamp == INT_MAX )
+      {
+         memset( vg->mark, 0, cur->n * sizeof( int ) );
+         vg->mark_stamp = 0;
+      }
+      int stamp = ++vg->mark_stamp;
+      for( int k = 0; k < degree; ++k ) vg->mark[ old_adj[ k ].index ] = stamp;
+
+      int fresh = 0;
+      for( int k = i; k < group_end; ++k )
+      {
+         if( vg->mark[ batch[ k ].finish ] == stamp ) continue;
+         vg->mark[ batch[ k ].finish ] = stamp;
+         batch[ i + fresh++ ] = batch[ k ];
+      }
+
+      if( fresh > 0 )
+      {
+         Data* adj = (Data*) malloc( ( degree + fresh ) * sizeof( Data ) );
+         ok = adj != NULL;
+
+         if( ok )
+         {
+            created[ n_created++ ] = adj;
+            memcpy( adj, old_adj, degree * sizeof( Data ) );
+            for( int k = 0; k < fresh; ++k )
+            {
+               adj[ degree + k ].index = batch[ i + k ].finish;
+               adj[ degree + k ].weight = batch[ i + k ].weight;
+            }
+
+            if( page == cur->pages[ u / SNAPSHOT_PAGE ] )
+            {
+               // primera modificación de esta página en el lote: se copia
+               page = (SnapshotPage*) malloc( sizeof( SnapshotPage ) );
+               ok = page && retired_push( retired, cur->pages[ u / SNAPSHOT_PAGE ], &cap );
+               if( page )
+               {
+                  created[ n_created++ ] = page;
+                  memcpy( page, cur->pages[ u / SNAPSHOT_PAGE ], sizeof( SnapshotPage ) );
+                  pages[ u / SNAPSHOT_PAGE ] = page;
+               }
+            }
+
+            if( ok && !in_base( vg, old_adj ) ) ok = retired_push( retired, (void*) old_adj, &cap );
+
+            if( ok )
+            {
+               page->adj[ u % SNAPSHOT_PAGE ] = adj;
+               page->degree[ u % SNAPSHOT_PAGE ] = degree + fresh;
+               added += fresh;
+            }
+         }
+      }
+
+      i = group_end;
+   }
+
+   if( !ok || added == 0 )
+   {
+      for( int k = 0; k < n_created; ++k ) free( created[ k ] );
+      if( retired ) free( retired->ptrs );
+      free( retired );
+      free( pages );
+      free( next );
+   }
+   else
+   {
+      next->version = cur->version + 1;
+      next->n = cur->n;
+      next->pages = pages;
+
+      __atomic_store_n( &vg->current, next, __ATOMIC_SEQ_CST );
+      __atomic_store_n( &vg->version, next->version, __ATOMIC_SEQ_CST );
+      // un lector que lea |version| ya encuentra en |current| esa versión o una más nueva
+
+      retired->version = cur->version;
+      retired->snapshot = cur;
+      if( vg->retired_last ) vg->retired_last->next = retired;
+      else vg->retired = retired;
+      vg->retired_last = retired;
+
+      versioned_reclaim( vg );
+   }
+
+   pthread_mutex_unlock( &vg->lock );
+
+   free( created );
+   free( batch );
+
+   return ok ? added : -1;
+}
+
+/**
+ * @brief Agrega una arista con peso como una versión nueva. Ver
+ * VersionedGraph_AddWeightedEdges().
+ *
+ * @return true si la arista se agregó; false si ya existía, si alguno de los vértices no existe
+ * o si no hubo memoria.
+ */
+bool VersionedGraph_AddWeightedEdge( VersionedGraph* vg, int start, int finish, float weight )
+{
+   Edge e = { start, finish, weight };
+   return VersionedGraph_AddWeightedEdges( vg, &e, 1 ) > 0;
+}
+
+/**
+ * @brief Fija la versión actual para el lector |reader| y la devuelve. La versión no cambia ni
+ * se libera hasta VersionedGraph_Unpin(), aunque se publiquen otras.
+ *
+ * Ejemplo
+ * @code
+   const Snapshot* s = VersionedGraph_Pin( vg, reader );
+   for( int k = 0; k < Snapshot_GetDegree( s, idx ); ++k )
+   {
+      Data d = Snapshot_GetNeighbors( s, idx )[ k ];
+      // ...
+   }
+   VersionedGraph_Unpin( vg, reader );
+   @endcode
+ *
+ * @param vg     El grafo con versiones.
+ * @param reader El número del lector; cada hilo lector usa uno distinto.
+ *
+ * @pre El lector no tiene otra versión fija.
+ */
+const Snapshot* VersionedGraph_Pin( VersionedGraph* vg, int reader )
+{
+   assert( 0 <= reader && reader < vg->n_readers );
+   assert( vg->readers[ reader ].version == 0 );
+
+   uint64_t version = __atomic_load_n( &vg->version, __ATOMIC_SEQ_CST );
+   __atomic_store_n( &vg->readers[ reader ].version, version, __ATOMIC_SEQ_CST );
+   // a partir de aquí ningún escritor libera versiones >= |version|, y |current| es una de ellas
+
+   return __atomic_load_n( &vg->current, __ATOMIC_SEQ_CST );
+}
+
+/**
+ * @brief Suelta la versión fijada por el lector |reader|.
+ */
+void VersionedGraph_Unpin( VersionedGraph* vg, int reader )
+{
+   assert( 0 <= reader && reader < vg->n_readers );
+
+   __atomic_store_n( &vg->readers[ reader ].version, 0, __ATOMIC_RELEASE );
+}
+
+/**
+ * @brief Devuelve cuántos vecinos tiene el vértice con índice |vertex_idx| en la versión |s|.
+ */
+int Snapshot_GetDegree( const Snapshot* s, int vertex_idx )
+{
+   assert( 0 <= vertex_idx && vertex_idx < s->n );
+
+   return s->pages[ vertex_idx / SNAPSHOT_PAGE ]->degree[ vertex_idx % SNAPSHOT_PAGE ];
+}
+
+/**
+ * @brief Devuelve los vecinos (índice y peso) del vértice con índice |vertex_idx| en la
+ * versión |s|, en un arreglo de Snapshot_GetDegree() elementos.
+ */
+const Data* Snapshot_GetNeighbors( const Snapshot* s, int vertex_idx )
+{
+   assert( 0 <= vertex_idx && vertex_idx < s->n );
+
+   return s->pages[ vertex_idx / SNAPSHOT_PAGE ]->adj[ vertex_idx % SNAPSHOT_PAGE ];
+}
+
+/**
+ * @brief Devuelve el número de la versión |s|. Las versiones se numeran desde 1.
+ */
+uint64_t Snapshot_GetVersion( const Snapshot* s )
+{
+   return s->version;
+}
+
+//----------------------------------------------------------------------
+//                           Caminos más cortos dinámicos: 
+//----------------------------------------------------------------------
+
+/**
+ * @brief Árbol de caminos más cortos desde un origen que se repara al cambiar pesos.
+ *
+ * SPTree_SetWeight() cambia el peso de una arista y corrige el árbol sólo en la región
+ * afectada (Ramalingam-Reps): si el peso baja, se propaga la mejora desde la punta de la
+ * arista; si sube y la arista está en el árbol, se recalculan sólo los vértices de su subárbol,
+ * partiendo de sus mejores aristas de entrada desde fuera del subárbol.
+ *
+ * Si el grafo cambia por otro medio (Graph_AddEdge(), Graph_SetWeight(), otro SPTree, ...) el
+ * árbol lo detecta por el contador de versión del grafo y se recalcula completo en la
+ * siguiente consulta.
+ */
+typedef struct
+{
+   Graph* graph;
+   int source;         ///< llave del origen (su índice cambia con Graph_Reorder())
+   uint64_t version;   ///< versión del grafo con la que coincide el árbol
+   Search* tree;       ///< dist y pred forman el árbol
+   bool repaired;      ///< la lista de tocados de |tree| ya no es confiable
+   int* stack;
+   int* mark;          ///< mark[ v ] == stamp si v está en el subárbol afectado
+   int stamp;
+   Heap heap;
+} SPTree;
+
+// recalcula el árbol completo
+static bool sptree_rebuild( SPTree* t )
+{
+   Graph* g = t->graph;
+   const CSR* out = out_edges( g );
+   int source_idx = find_key( g, t->source );
+   if( !out || source_idx == -1 ) return false;
+
+   if( t->tree->n != out->n )
+   {
+      // se agregaron vértices: la memoria de trabajo se vuelve a pedir con el nuevo tamaño
+      int n = out->n > 0 ? out->n : 1;
+      int* stack = (int*) realloc( t->stack, n * sizeof( int ) );
+      if( stack ) t->stack = stack;
+      int* mark = (int*) realloc( t->mark, n * sizeof( int ) );
+      if( mark ) t->mark = mark;
+      if( !stack || !mark ) return false;
+
+      memset( t->mark, 0, n * sizeof( int ) );
+      t->stamp = 0;
+
+      Search* tree = search_new( out->n );
+      if( !tree ) return false;
+      search_delete( &t->tree );
+      t->tree = tree;
+      t->repaired = false;
+   }
+
+   if( t->repaired )
+   {
+      for( int v = 0; v < t->tree->n; ++v )
+      {
+         t->tree->dist[ v ] = INFINITY;
+         t->tree->pred[ v ] = -1;
+      }
+      t->tree->n_touched = 0;
+      t->repaired = false;
+   }
+
+   if( !search_run( t->tree, out, source_idx, -1, INFINITY, NULL, NULL, NULL ) ) return false;
+
+   t->version = g->version;
+   return true;
+}
+
+// propaga desde los vértices en el montículo las distancias que bajaron (Dijkstra sobre la
+// región afectada). Si |only_marked| es true sólo se corrigen vértices del subárbol marcado.
+// Devuelve el número de vértices cuya distancia cambió, o -1 si no hubo memoria.
+static int sptree_propagate( SPTree* t, const CSR* out, bool only_marked )
+{
+   float* dist = t->tree->dist;
+   int* pred = t->tree->pred;
+   int changed = 0;
+
+   while( !heap_is_empty( &t->heap ) )
+   {
+      Data top = heap_pop( &t->heap );
+      int u = top.index;
+      if( top.weight > dist[ u ] ) continue;
+
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         if( only_marked && t->mark[ v ] != t->stamp ) continue;
+
+         float d = dist[ u ] + out->adj[ e ].weight;
+         if( d < dist[ v ] )
+         {
+            dist[ v ] = d;
+            pred[ v ] = u;
+            if( !heap_push( &t->heap, v, d ) ) return -1;
+            ++changed;
+         }
+      }
+   }
+
+   return changed;
+}
+
+// la arista u->v bajó de peso
+static int sptree_decrease( SPTree* t, const CSR* out, int u, int v, float weight )
+{
+   float* dist = t->tree->dist;
+
+   if( dist[ u ] == INFINITY || dist[ u ] + weight >= dist[ v ] ) return 0;
+
+   dist[ v ] = dist[ u ] + weight;
+   t->tree->pred[ v ] = u;
+
+   heap_clear( &t->heap );
+   if( !heap_push( &t->heap, v, dist[ v ] ) ) return -1;
+
+   int changed = sptree_propagate( t, out, false );
+   return changed == -1 ? -1 : changed + 1;
+}
+
+// la arista u->v subió de peso
+static int sptree_increase( SPTree* t, const CSR* out, const CSR* in, int u, int v )
+{
+   float* dist = t->tree->dist;
+   int* pred = t->tree->pred;
+
+   if( pred[ v ] != u ) return 0;
+   // la arista no está en el árbol: ninguna distancia cambia
+
+   // el subárbol de |v| es la región afectada
+   if( ++t->stamp == INT_MAX )
+   {
+      memset( t->mark, 0, t->tree->n * sizeof( int ) );
+      t->stamp = 1;
+   }
+
+   int len = 0;
+   int top = 0;
+   t->stack[ top++ ] = v;
+   t->mark[ v ] = t->stamp;
+   while( top > 0 )
+   {
+      int x = t->stack[ --top ];
+      t->stack[ t->tree->n - ++len ] = x;
+      // la pila crece desde el inicio y los visitados se guardan desde el final
+
+      for( int e = out->start[ x ]; e < out->start[ x + 1 ]; ++e )
+      {
+         int y = out->adj[ e ].index;
+         if( pred[ y ] == x && t->mark[ y ] != t->stamp )
+         {
+            t->mark[ y ] = t->stamp;
+            t->stack[ top++ ] = y;
+         }
+      }
+   }
+   const int* affected = &t->stack[ t->tree->n - len ];
+
+   for( int k = 0; k < len; ++k )
+   {
+      dist[ affected[ k ] ] = INFINITY;
+      pred[ affected[ k ] ] = -1;
+   }
+
+   // cada vértice afectado parte de su mejor arista de entrada desde fuera del subárbol
+   heap_clear( &t->heap );
+   for( int k = 0; k < len; ++k )
+   {
+      int y = affected[ k ];
+      for( int e = in->start[ y ]; e < in->start[ y + 1 ]; ++e )
+      {
+         int z = in->adj[ e ].index;
+         if( t->mark[ z ] == t->stamp || dist[ z ] == INFINITY ) continue;
+
+         float d = dist[ z ] + in->adj[ e ].weight;
+         if( d < dist[ y ] )
+         {
+            dist[ y ] = d;
+            pred[ y ] = z;
+         }
+      }
+      if( dist[ y ] < INFINITY && !heap_push( &t->heap, y, dist[ y ] ) ) return -1;
+   }
+
+   return sptree_propagate( t, out, true ) == -1 ? -1 : len;
+}
+
+/**
+ * @brief Libera un árbol creado con Graph_NewSPTree().
+ *
+ * @param p_tree Referencia al árbol; queda en NULL.
+ */
+void SPTree_Delete( SPTree** p_tree )
+{
+   assert( *p_tree );
+
+   SPTree* t = *p_tree;
+   search_delete( &t->tree );
+   free( t->stack );
+   free( t->mark );
+   heap_free( &t->heap );
+   free( t );
+   *p_tree = NULL;
+}
+
+/**
+ * @brief Calcula el árbol de caminos más cortos desde el vértice |source|.
+ *
+ * @param g      El grafo. Debe vivir más que el árbol.
+ * @param source La llave del origen.
+ *
+ * @return El árbol, o NULL si el origen no existe o no hubo memoria. El cliente lo debe
+ * liberar con SPTree_Delete().
+ */
+SPTree* Graph_NewSPTree( Graph* g, int source )
+{
+   if( find_key( g, source ) == -1 ) return NULL;
+
+   SPTree* t = (SPTree*) calloc( 1, sizeof( SPTree ) );
+   if( !t ) return NULL;
+
+   t->graph = g;
+   t->source = source;
+   t->tree = search_new( g->len );
+   t->stack = (int*) malloc( ( g->len > 0 ? g->len : 1 ) * sizeof( int ) );
+   t->mark = (int*) calloc( g->len > 0 ? g->len : 1, sizeof( int ) );
+
+   if( !t->tree || !t->stack || !t->mark || !sptree_rebuild( t ) ) SPTree_Delete( &t );
+
+   return t;
+}
+
+/**
+ * @brief Cambia el peso de una arista (como Graph_SetWeight()) y repara el árbol.
+ *
+ * @param t      El árbol.
+ * @param start  Vértice de salida (el dato)
+ * @param finish Vertice de llegada (el dato)
+ * @param weight El nuevo peso.
+ *
+ * @return El número de vértices cuya distancia se corrigió o recalculó (el tamaño de la región
+ * afectada), o -1 si la arista no existe o no hubo memoria. Si el árbol estaba desactualizado
+ * se recalcula completo y se devuelve el número de vértices.
+ */
+int SPTree_SetWeight( SPTree* t, int start, int finish, float weight )
+{
+   Graph* g = t->graph;
+
+   int u = find_key( g, start );
+   int v = find_key( g, finish );
+   if( u == -1 || v == -1 ) return -1;
+
+   bool stale = t->version != g->version;
+   double old = Graph_GetWeight( g, start, finish );
+
+   if( !Graph_SetWeight( g, start, finish, weight ) ) return -1;
+
+   const CSR* out = out_edges( g );
+   const CSR* in = in_edges( g );
+   if( !out || !in ) return -1;
+
+   if( stale ) return sptree_rebuild( t ) ? g->len : -1;
+
+   t->repaired = true;
+   t->version = g->version;
+
+   bool undirected = g->type == eGraphType_UNDIRECTED;
+   int changed = 0;
+
+   if( weight < old )
+   {
+      changed = sptree_decrease( t, out, u, v, weight );
+      if( changed != -1 && undirected )
+      {
+         int back = sptree_decrease( t, out, v, u, weight );
+         changed = back == -1 ? -1 : changed + back;
+      }
+   }
+   else if( weight > old )
+   {
+      changed = sptree_increase( t, out, in, u, v );
+      if( changed == 0 && undirected ) changed = sptree_increase( t, out, in, v, u );
+      // a lo más una de las dos direcciones está en el árbol
+   }
+
+   if( changed == -1 ) t->version = 0;
+   // el árbol quedó a medias: se recalculará en la siguiente consulta
+
+   return changed;
+}
+
+// recalcula el árbol si el grafo cambió por otro medio
+static bool sptree_sync( SPTree* t )
+{
+   return t->version == t->graph->version || sptree_rebuild( t );
+}
+
+/**
+ * @brief Devuelve la distancia desde el origen hasta el vértice |key|.
+ *
+ * @return La distancia; INFINITY si no se puede llegar, o -1 si el vértice no existe o no hubo
+ * memoria para recalcular el árbol.
+ */
+float SPTree_GetDistance( SPTree* t, int key )
+{
+   int idx = find_key( t->graph, key );
+   if( idx == -1 || !sptree_sync( t ) ) return -1.0f;
+
+   return t->tree->dist[ idx ];
+}
+
+/**
+ * @brief Copia en |path| el camino más corto desde el origen hasta el vértice |key|.
+ *
+ * @return false si el vértice no existe, no se puede llegar a él o no hubo memoria. El cliente
+ * debe liberar el camino con Path_Clear().
+ */
+bool SPTree_GetPath( SPTree* t, int key, Path* path )
+{
+   int idx = find_key( t->graph, key );
+   if( idx == -1 || !sptree_sync( t ) || t->tree->dist[ idx ] == INFINITY ) return false;
+
+   return search_path( t->tree, idx, path );
+}
+
+//----------------------------------------------------------------------
+//                           Caché de rutas: 
+//----------------------------------------------------------------------
+
+// número de particiones de la caché; cada una con su candado (potencia de 2)
+#define ROUTE_CACHE_SHARDS 16
+
+/** Tipos de consulta que guarda la caché de rutas.
+ */
+typedef enum
+{
+   eRouteQuery_FASTEST,       ///< menor suma de pesos (Dijkstra)
+   eRouteQuery_FEWEST_STOPS,  ///< menor número de aristas (BFS)
+} eRouteQuery;
+
+typedef struct
+{
+   int start;        ///< llaves del origen y del destino
+   int finish;
+   int type;
+   int len;          ///< número de vértices de la ruta; 0 si no hay ruta
+   int* vertices;    ///< índices de los vértices de la ruta
+   int cap;          ///< capacidad de |vertices|
+   float cost;       ///< suma de pesos de la ruta
+   uint64_t version; ///< versión del grafo con la que se calculó
+   int prev;         ///< vecinos en la lista LRU; -1 en los extremos
+   int next;
+   int chain;        ///< siguiente entrada en la misma casilla de la tabla hash; -1 si no hay
+} RouteEntry;
+
+typedef struct
+{
+   int lock;
+   int len;             ///< entradas usadas
+   int cap;             ///< máximo de entradas
+   int head;            ///< la entrada usada más recientemente; -1 si no hay
+   int tail;            ///< la usada hace más tiempo; es la que se desaloja
+   int* buckets;        ///< primera entrada de cada casilla; -1 si está vacía
+   int mask;            ///< número de casillas menos 1 (es potencia de 2)
+   RouteEntry* entries;
+   uint64_t hits;
+   uint64_t misses;
+} __attribute__(( aligned( 64 ) )) RouteShard;
+
+/**
+ * @brief Caché de rutas (origen, destino, tipo de consulta) con desalojo LRU.
+ *
+ * La caché está dividida en ROUTE_CACHE_SHARDS particiones, cada una con su propio candado,
+ * así que varios hilos la pueden consultar a la vez. Cada ruta guardada recuerda la versión del
+ * grafo con la que se calculó; cualquier cambio al grafo (Graph_AddEdge(),
+ * Graph_AddWeightedEdge(), Graph_SetWeight(), ...) cambia la versión y las rutas viejas se
+ * recalculan al pedirlas, sin tener que vaciar la caché.
+ *
+ * Las rutas que faltan se calculan sin tener el candado de su partición, así que mientras un
+ * hilo busca una ruta nueva los demás siguen leyendo de esa partición.
+ *
+ * El grafo no se debe modificar mientras otro hilo consulta la caché.
+ */
+typedef struct
+{
+   Graph* graph;
+   int graph_lock; ///< protege la construcción perezosa del índice CSR del grafo
+   int spare_lock; ///< protege a |spare|
+   Search** spare; ///< memoria de trabajo libre; cada búsqueda en curso toma una
+   int n_spare;
+   int cap_spare;
+   RouteShard shards[ ROUTE_CACHE_SHARDS ];
+} RouteCache;
+
+// avisa al procesador que estamos en una espera activa
+static inline void cpu_relax( void )
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+   __builtin_ia32_pause();
+#elif defined( __aarch64__ )
+   __asm__ __volatile__( "yield" );
+#endif
+}
+
+// candado de espera activa para secciones cortas; si la espera se alarga cede el procesador
+static inline void spin_lock( int* lock )
+{
+   int spins = 0;
+   while( __atomic_exchange_n( lock, 1, __ATOMIC_ACQUIRE ) )
+   {
+      while( __atomic_load_n( lock, __ATOMIC_RELAXED ) )
+      {
+         if( ++spins < 64 ) cpu_relax();
+         else sched_yield();
+      }
+   }
+}
+
+static inline void spin_unlock( int* lock )
+{
+   __atomic_store_n( lock, 0, __ATOMIC_RELEASE );
+}
+
+static inline uint64_t route_hash( int start, int finish, int type )
+{
+   uint64_t h = (uint64_t) (uint32_t) start << 32 | (uint32_t) finish;
+   h ^= (uint64_t) type * 0x9e3779b97f4a7c15ull;
+   h ^= h >> 33;
+   h *= 0xff51afd7ed558ccdull;
+   h ^= h >> 33;
+   // mezcla de MurmurHash3
+   return h;
+}
+
+static void lru_unlink( RouteShard* sh, int i )
+{
+   RouteEntry* e = &sh->entries[ i ];
+   if( e->prev != -1 ) sh->entries[ e->prev ].next = e->next;
+   else sh->head = e->next;
+   if( e->next != -1 ) sh->entries[ e->next ].prev = e->prev;
+   else sh->tail = e->prev;
+}
+
+static void lru_push_front( RouteShard* sh, int i )
+{
+   RouteEntry* e = &sh->entries[ i ];
+   e->prev = -1;
+   e->next = sh->head;
+   if( sh->head != -1 ) sh->entries[ sh->head ].prev = i;
+   sh->head = i;
+   if( sh->tail == -1 ) sh->tail = i;
+}
+
+// saca a la entrada |i| de su casilla de la tabla hash
+static void chain_unlink( RouteShard* sh, int i, uint64_t h )
+{
+   int* link = &sh->buckets[ ( h >> 8 ) & sh->mask ];
+   while( *link != i ) link = &sh->entries[ *link ].chain;
+   *link = sh->entries[ i ].chain;
+}
+
+// BFS desde |src| que deja el árbol en |s|; la cola es la propia lista de tocados
+static void search_bfs( Search* s, const CSR* out, int src, int target )
+{
+   search_reset( s );
+   search_relax( s, src, 0.0f, -1 );
+
+   for( int head = 0; head < s->n_touched; ++head )
+   {
+      int u = s->touched[ head ];
+      if( u == target ) break;
+
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         if( s->dist[ v ] == INFINITY ) search_relax( s, v, s->dist[ u ] + 1.0f, u );
+      }
+   }
+}
+
+// toma memoria de trabajo para una búsqueda de |n| vértices; NULL si no hubo memoria
+static Search* route_search_take( RouteCache* c, int n )
+{
+   Search* s = NULL;
+
+   spin_lock( &c->spare_lock );
+   if( c->n_spare > 0 ) s = c->spare[ --c->n_spare ];
+   spin_unlock( &c->spare_lock );
+
+   if( s && s->n != n ) search_delete( &s );
+   return s ? s : search_new( n );
+}
+
+// regresa la memoria de trabajo de route_search_take() para la siguiente búsqueda
+static void route_search_give( RouteCache* c, Search* s )
+{
+   spin_lock( &c->spare_lock );
+   if( c->n_spare == c->cap_spare )
+   {
+      int cap = c->cap_spare > 0 ? c->cap_spare * 2 : 4;
+      Search** spare = (Search**) realloc( c->spare, cap * sizeof( Search* ) );
+      if( spare )
+      {
+         c->spare = spare;
+         c->cap_spare = cap;
+      }
+   }
+   if( c->n_spare < c->cap_spare )
+   {
+      c->spare[ c->n_spare++ ] = s;
+      s = NULL;
+   }
+   spin_unlock( &c->spare_lock );
+
+   if( s ) search_delete( &s );
+}
+
+// calcula la ruta de |src| a |dst| y la escribe en |path|, con su costo en |cost|; devuelve el
+// número de vértices (0 si no hay ruta)
+static int route_compute( Search* s, const CSR* out, int src, int dst, int type, int path[], float* cost )
+{
+   if( type == eRouteQuery_FASTEST )
+   {
+      if( !search_run( s, out, src, dst, INFINITY, NULL, NULL, NULL ) ) return -1;
+   }
+   else
+   {
+      search_bfs( s, out, src, dst );
+   }
+
+   *cost = INFINITY;
+   if( s->dist[ dst ] == INFINITY ) return 0;
+
+   int len = 0;
+   for( int v = dst; v != -1; v = s->pred[ v ] ) ++len;
+   for( int v = dst, k = len - 1; v != -1; v = s->pred[ v ], --k ) path[ k ] = v;
+
+   if( type == eRouteQuery_FASTEST )
+   {
+      *cost = s->dist[ dst ];
+   }
+   else
+   {
+      *cost = 0.0f;
+      for( int k = 1; k < len; ++k )
+      {
+         *cost += out->adj[ csr_find_edge( out, path[ k - 1 ], path[ k ] ) ].weight;
+      }
+   }
+
+   return len;
+}
+
+// guarda una ruta en la entrada |e|; false si no hubo memoria
+static bool route_store( RouteEntry* e, const int path[], int len, float cost )
+{
+   if( len > e->cap )
+   {
+      int* vertices = (int*) realloc( e->vertices, len * sizeof( int ) );
+      if( !vertices ) return false;
+      e->vertices = vertices;
+      e->cap = len;
+   }
+
+   if( len > 0 ) memcpy( e->vertices, path, len * sizeof( int ) );
+   e->len = len;
+   e->cost = cost;
+   return true;
+}
+
+/**
+ * @brief Libera una caché creada con Graph_NewRouteCache().
+ *
+ * @param p_cache Referencia a la caché; queda en NULL.
+ */
+void RouteCache_Delete( RouteCache** p_cache )
+{
+   assert( *p_cache );
+
+   RouteCache* c = *p_cache;
+   for( int k = 0; k < ROUTE_CACHE_SHARDS; ++k )
+   {
+      RouteShard* sh = &c->shards[ k ];
+      for( int i = 0; sh->entries && i < sh->len; ++i ) free( sh->entries[ i ].vertices );
+      free( sh->entries );
+      free( sh->buckets );
+   }
+   for( int k = 0; k < c->n_spare; ++k ) search_delete( &c->spare[ k ] );
+   free( c->spare );
+   free( c );
+   *p_cache = NULL;
+}
+
+/**
+ * @brief Crea una caché de rutas para el grafo |g|.
+ *
+ * @param g        El grafo. Debe vivir más que la caché.
+ * @param capacity Número máximo de rutas guardadas (se reparte entre las particiones).
+ *
+ * @return La caché, o NULL si no hubo memoria. El cliente la debe liberar con
+ * RouteCache_Delete().
+ */
+RouteCache* Graph_NewRouteCache( Graph* g, int capacity )
+{
+   RouteCache* c = (RouteCache*) aligned_alloc( 64, sizeof( RouteCache ) );
+   if( !c ) return NULL;
+   memset( c, 0, sizeof( RouteCache ) );
+
+   c->graph = g;
+
+   int per_shard = ( capacity + ROUTE_CACHE_SHARDS - 1 ) / ROUTE_CACHE_SHARDS;
+   if( per_shard < 1 ) per_shard = 1;
+
+   int buckets = 4;
+   while( buckets < 2 * per_shard ) buckets *= 2;
+
+   bool ok = true;
+   for( int k = 0; k < ROUTE_CACHE_SHARDS; ++k )
+   {
+      RouteShard* sh = &c->shards[ k ];
+      sh->cap = per_shard;
+      sh->head = sh->tail = -1;
+      sh->mask = buckets - 1;
+      sh->entries = (RouteEntry*) malloc( per_shard * sizeof( RouteEntry ) );
+      sh->buckets = (int*) malloc( buckets * sizeof( int ) );
+
+      if( !sh->entries || !sh->buckets )
+      {
+         ok = false;
+         continue;
+      }
+      for( int b = 0; b < buckets; ++b ) sh->buckets[ b ] = -1;
+   }
+
+   if( !ok ) RouteCache_Delete( &c );
+
+   return c;
+}
+
+// busca la entrada de la consulta en la partición; -1 si no está. Requiere el candado.
+static int route_lookup( const RouteShard* sh, uint64_t h, int start, int finish, int type )
+{
+   int i = sh->buckets[ ( h >> 8 ) & sh->mask ];
+   while( i != -1 && ( sh->entries[ i ].start != start || sh->entries[ i ].finish != finish ||
+                       sh->entries[ i ].type != type ) )
+   {
+      i = sh->entries[ i ].chain;
+   }
+   return i;
+}
+
+/**
+ * @brief Devuelve la ruta de |start| a |finish|, de la caché si está vigente o calculándola y
+ * guardándola si no. Se puede llamar desde varios hilos a la vez.
+ *
+ * @param c      La caché.
+ * @param start  La llave del origen.
+ * @param finish La llave del destino.
+ * @param type   El tipo de ruta.
+ * @param out    Arreglo de tamaño Graph_GetLen() para los índices de los vértices de la ruta,
+ *               del origen al destino.
+ * @param cost   Si no es NULL, aquí se escribe la suma de pesos de la ruta.
+ *
+ * @return El número de vértices de la ruta; 0 si no hay ruta, o -1 si alguno de los vértices no
+ * existe o no hubo memoria.
+ */
+int RouteCache_Query( RouteCache* c, int start, int finish, eRouteQuery type, int out[], float* cost )
+{
+   uint64_t h = route_hash( start, finish, type );
+   RouteShard* sh = &c->shards[ h & ( ROUTE_CACHE_SHARDS - 1 ) ];
+   uint64_t version = __atomic_load_n( &c->graph->version, __ATOMIC_ACQUIRE );
+
+   spin_lock( &sh->lock );
+
+   int i = route_lookup( sh, h, start, finish, type );
+   if( i != -1 && sh->entries[ i ].version == version )
+   {
+      ++sh->hits;
+
+      if( sh->head != i )
+      {
+         lru_unlink( sh, i );
+         lru_push_front( sh, i );
+      }
+
+      const RouteEntry* e = &sh->entries[ i ];
+      int len = e->len;
+      if( len > 0 ) memcpy( out, e->vertices, len * sizeof( int ) );
+      if( cost ) *cost = e->cost;
+
+      spin_unlock( &sh->lock );
+      return len;
+   }
+
+   ++sh->misses;
+   spin_unlock( &sh->lock );
+
+   // la ruta se calcula sin el candado de la partición, con memoria de trabajo propia
+   spin_lock( &c->graph_lock );
+   const CSR* csr = out_edges( c->graph );
+   int src = find_key( c->graph, start );
+   int dst = find_key( c->graph, finish );
+   version = c->graph->version;
+   spin_unlock( &c->graph_lock );
+
+   if( !csr || src == -1 || dst == -1 ) return -1;
+
+   Search* s = route_search_take( c, csr->n );
+   if( !s ) return -1;
+
+   float route_cost = INFINITY;
+   int len = route_compute( s, csr, src, dst, type, out, &route_cost );
+   route_search_give( c, s );
+   if( len < 0 ) return -1;
+
+   if( cost ) *cost = route_cost;
+
+   // se guarda, salvo que otro hilo la haya guardado mientras tanto
+   spin_lock( &sh->lock );
+
+   i = route_lookup( sh, h, start, finish, type );
+   if( i == -1 )
+   {
+      // entrada nueva: una libre o la usada hace más tiempo
+      if( sh->len < sh->cap )
+      {
+         i = sh->len++;
+         sh->entries[ i ].vertices = NULL;
+         sh->entries[ i ].cap = 0;
+      }
+      else
+      {
+         i = sh->tail;
+         RouteEntry* old = &sh->entries[ i ];
+         chain_unlink( sh, i, route_hash( old->start, old->finish, old->type ) );
+         lru_unlink( sh, i );
+      }
+
+      RouteEntry* e = &sh->entries[ i ];
+      e->start = start;
+      e->finish = finish;
+      e->type = type;
+      e->chain = sh->buckets[ ( h >> 8 ) & sh->mask ];
+      e->version = UINT64_MAX;
+      sh->buckets[ ( h >> 8 ) & sh->mask ] = i;
+      lru_push_front( sh, i );
+   }
+   else if( sh->head != i )
+   {
+      lru_unlink( sh, i );
+      lru_push_front( sh, i );
+   }
+
+   RouteEntry* e = &sh->entries[ i ];
+   if( e->version != version )
+   {
+      e->version = route_store( e, out, len, route_cost ) ? version : UINT64_MAX;
+      // si no hubo memoria para guardarla, ninguna versión del grafo coincide y se volverá a
+      // calcular; la respuesta de esta consulta sigue siendo válida
+   }
+
+   spin_unlock( &sh->lock );
+
+   return len;
+}
+
+/**
+ * @brief Devuelve cuántas consultas se respondieron desde la caché y cuántas se calcularon.
+ */
+void RouteCache_GetStats( RouteCache* c, uint64_t* hits, uint64_t* misses )
+{
+   *hits = *misses = 0;
+   for( int k = 0; k < ROUTE_CACHE_SHARDS; ++k )
+   {
+      spin_lock( &c->shards[ k ].lock );
+      *hits += c->shards[ k ].hits;
+      *misses += c->shards[ k ].misses;
+      spin_unlock( &c->shards[ k ].lock );
+   }
+}
+
+//----------------------------------------------------------------------
+//                           Distancias en lote: 
+//----------------------------------------------------------------------
+
+// Dijkstra desde |src| que se detiene en cuanto se asientan todos los vértices marcados en
+// |targets| (|remaining| es cuántos son). ret: false si no hubo memoria.
+static bool search_until_settled( Search* s, const CSR* out, int src, const uint64_t* targets,
+                                  int remaining )
+{
+   search_reset( s );
+   search_relax( s, src, 0.0f, -1 );
+   if( !heap_push( &s->heap, src, 0.0f ) ) return false;
+
+   while( remaining > 0 && !heap_is_empty( &s->heap ) )
+   {
+      Data top = heap_pop( &s->heap );
+      int u = top.index;
+      if( top.weight > s->dist[ u ] ) continue;
+
+      if( bitmap_get( targets, u ) ) --remaining;
+      // cada vértice se asienta una sola vez
+
+      for( int e = out->start[ u ]; e < out->start[ u + 1 ]; ++e )
+      {
+         int v = out->adj[ e ].index;
+         float d = s->dist[ u ] + out->adj[ e ].weight;
+         if( d < s->dist[ v ] )
+         {
+            search_relax( s, v, d, u );
+            if( !heap_push( &s->heap, v, d ) ) return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+// distancias desde el índice |src| a los índices |dst[ 0..m )| (-1 si el destino no existe).
+// |targets| es un mapa de bits de n bits en ceros, y así se queda. Devuelve cuántos destinos son
+// alcanzables o -1 si no hubo memoria.
+static int distances_from( Search* s, const CSR* out, uint64_t* targets, int src, const int dst[],
+                           int m, float dist[] )
+{
+   int remaining = 0;
+   for( int k = 0; k < m; ++k )
+   {
+      if( dst[ k ] != -1 && !bitmap_get( targets, dst[ k ] ) )
+      {
+         bitmap_set( targets, dst[ k ] );
+         ++remaining;
+      }
+   }
+
+   bool ok = search_until_settled( s, out, src, targets, remaining );
+
+   int reached = 0;
+   for( int k = 0; k < m; ++k )
+   {
+      if( dst[ k ] == -1 )
+      {
+         dist[ k ] = -1.0f;
+         continue;
+      }
+
+      targets[ dst[ k ] >> 6 ] = 0;
+      // sólo hay marcas de destinos, así que se puede borrar la palabra completa
+      dist[ k ] = s->dist[ dst[ k ] ];
+      if( dist[ k ] < INFINITY ) ++reached;
+   }
+
+   return ok ? reached : -1;
+}
+
+/**
+ * @brief Calcula las distancias desde un origen hasta varios destinos con una sola búsqueda,
+ * que se detiene en cuanto se asientan todos los destinos.
+ *
+ * @param g    El grafo.
+ * @param src  La llave del origen.
+ * @param dsts Las llaves de los destinos (puede haber repetidas).
+ * @param n    Número de destinos.
+ * @param out  Arreglo de |n| elementos. out[ i ] es la distancia a dsts[ i ]: INFINITY si no se
+ *             puede llegar y -1 si el destino no existe.
+ *
+ * @return El número de destinos alcanzables, o -1 si el origen no existe o no hubo memoria.
+ */
+int Graph_DistancesFrom( Graph* g, int src, const int* dsts, int n, float out[] )
+{
+   int src_idx = find_key( g, src );
+   if( src_idx == -1 ) return -1;
+
+   const CSR* csr = out_edges( g );
+   Search* s = graph_search( g );
+   int* dst_idx = (int*) malloc( ( n > 0 ? n : 1 ) * sizeof( int ) );
+   uint64_t* targets = (uint64_t*) calloc( g->len / 64 + 1, sizeof( uint64_t ) );
+
+   int reached = -1;
+   if( csr && s && dst_idx && targets )
+   {
+      for( int k = 0; k < n; ++k ) dst_idx[ k ] = find_key( g, dsts[ k ] );
+
+      reached = distances_from( s, csr, targets, src_idx, dst_idx, n, out );
+   }
+
+   free( dst_idx );
+   free( targets );
+
+   return reached;
+}
+
+// pareja (origen, destino) de Graph_DistancesMany(), con su posición original
+typedef struct
+{
+   int src;
+   int dst;
+   int pos;
+} DistanceQuery;
+
+static int cmp_distance_query( const void* a, const void* b )
+{
+   const DistanceQuery* x = (const DistanceQuery*) a;
+   const DistanceQuery* y = (const DistanceQuery*) b;
+   if( x->src != y->src ) return ( x->src > y->src ) - ( x->src < y->src );
+   return ( x->pos > y->pos ) - ( x->pos < y->pos );
+}
+
+/**
+ * @brief Calcula las distancias de |n| parejas (origen, destino). Las parejas se agrupan por
+ * origen y cada origen distinto se resuelve con una sola búsqueda como en
+ * Graph_DistancesFrom(); los orígenes se reparten entre los hilos.
+ *
+ * @param g    El grafo.
+ * @param srcs Las llaves de los orígenes.
+ * @param dsts Las llaves de los destinos.
+ * @param n    Número de parejas.
+ * @param out  Arreglo de |n| elementos. out[ i ] es la distancia de srcs[ i ] a dsts[ i ]:
+ *             INFINITY si no se puede llegar y -1 si alguno de los dos no existe.
+ *
+ * @return El número de parejas con ruta, o -1 si no hubo memoria.
+ */
+int Graph_DistancesMany( Graph* g, const int* srcs, const int* dsts, int n, float out[] )
+{
+   const CSR* csr = out_edges( g );
+   DistanceQuery* q = (DistanceQuery*) malloc( ( n > 0 ? n : 1 ) * sizeof( DistanceQuery ) );
+   int* group = (int*) malloc( ( n + 1 ) * sizeof( int ) );
+   // inicio de cada grupo de parejas con el mismo origen
+   if( !csr || !q || !group )
+   {
+      free( q );
+      free( group );
+      return -1;
+   }
+
+   int len = 0;
+   for( int k = 0; k < n; ++k )
+   {
+      int src = find_key( g, srcs[ k ] );
+      int dst = find_key( g, dsts[ k ] );
+      if( src == -1 || dst == -1 ) out[ k ] = -1.0f;
+      else q[ len++ ] = (DistanceQuery){ src, dst, k };
+   }
+   qsort( q, len, sizeof( DistanceQuery ), cmp_distance_query );
+
+   int groups = 0;
+   for( int k = 0; k < len; ++k )
+   {
+      if( k == 0 || q[ k ].src != q[ k - 1 ].src ) group[ groups++ ] = k;
+   }
+   group[ groups ] = len;
+
+   int reached = 0;
+   bool ok = true;
+
+   #pragma omp parallel reduction( +:reached )
+   {
+      Search* s = search_new( g->len );
+      uint64_t* targets = (uint64_t*) calloc( g->len / 64 + 1, sizeof( uint64_t ) );
+      int* dst = (int*) malloc( ( len > 0 ? len : 1 ) * sizeof( int ) );
+      float* dist = (float*) malloc( ( len > 0 ? len : 1 ) * sizeof( float ) );
+
+      if( !s || !targets || !dst || !dist ) __atomic_store_n( &ok, false, __ATOMIC_RELAXED );
+
+      #pragma omp for schedule( dynamic, 1 )
+      for( int k = 0; k < groups; ++k )
+      {
+         if( !__atomic_load_n( &ok, __ATOMIC_RELAXED ) ) continue;
+
+         int m = group[ k + 1 ] - group[ k ];
+         const DistanceQuery* batch = &q[ group[ k ] ];
+         for( int j = 0; j < m; ++j ) dst[ j ] = batch[ j ].dst;
+
+         int r = distances_from( s, csr, targets, batch[ 0 ].src, dst, m, dist );
+         if( r == -1 )
+         {
+            __atomic_store_n( &ok, false, __ATOMIC_RELAXED );
+            continue;
+         }
+
+         for( int j = 0; j < m; ++j ) out[ batch[ j ].pos ] = dist[ j ];
+         reached += r;
+      }
+
+      search_delete( &s );
+      free( targets );
+      free( dst );
+      free( dist );
+   }
+
+   free( q );
+   free( group );
+
+   return ok ? reached : -1;
+}
+
+//----------------------------------------------------------------------
+//                           Consultas intercaladas: 
+//----------------------------------------------------------------------
+
+// número de consultas en vuelo a la vez
+#define QUERY_GROUP 16
+
+/** Tipos de consulta de Graph_RunQueries().
+ */
+typedef enum
+{
+   eGraphQuery_IS_NEIGHBOR,  ///< ¿|finish| es vecino de |start|? (como Graph_IsNeighborOf())
+   eGraphQuery_WITHIN_HOPS,  ///< ¿se llega de |start| a |finish| en a lo más |max_hops| aristas?
+} eGraphQuery;
+
+/**
+ * @brief Una consulta para Graph_RunQueries().
+ */
+typedef struct
+{
+   eGraphQuery type;
+   int start;    ///< llave del vértice de salida
+   int finish;   ///< llave del vértice de llegada
+   int max_hops; ///< sólo para eGraphQuery_WITHIN_HOPS
+} GraphQuery;
+
+// etapas de una consulta; al final de cada una se pide (prefetch) la memoria que usará la
+// siguiente y se cede el turno a otra consulta
+enum
+{
+   QUERY_KEYS,     ///< pedir las casillas de la tabla de llaves
+   QUERY_PROBE,    ///< leerlas y pedir los vértices
+   QUERY_VERIFY,   ///< confirmar las llaves y empezar la consulta
+   QUERY_LIST,     ///< leer la cabeza de la lista de vecinos y pedir su primer nodo
+   QUERY_NODE,     ///< revisar un nodo y pedir el siguiente
+   QUERY_BFS_ADJ,  ///< leer el inicio de la adyacencia del vértice en turno y pedirla
+   QUERY_BFS_SCAN, ///< recorrer la adyacencia y pedir el inicio del siguiente vértice
+};
+
+// estado de una consulta en vuelo
+typedef struct
+{
+   int query;        ///< índice de la consulta; -1 si la casilla está libre
+   int stage;
+   int u;            ///< índices de los vértices de salida y de llegada
+   int v;
+   unsigned hu;      ///< casillas de sus llaves
+   unsigned hv;
+   const List* list;
+   const Node* node;
+
+   int x;            ///< vértice que se expande en el BFS, y su distancia (en aristas)
+   int depth;
+   int begin;        ///< su rango en el CSR
+   int end;
+   int* queue;       ///< parejas (vértice, distancia) por expandir
+   int head;
+   int tail;
+   int queue_cap;
+   int* seen;        ///< tabla hash de índices + 1 de los vértices ya vistos
+   int seen_len;
+   int seen_mask;
+   int root;         ///< vértice de salida del último BFS; los demás vistos están en |queue|
+} QuerySlot;
+
+// agrega |x| al conjunto de vistos de la consulta; false si ya estaba o si no hubo memoria
+// (en ese caso *|ok| queda en false)
+static bool slot_see( QuerySlot* q, int x, bool* ok )
+{
+   if( 2 * ( q->seen_len + 1 ) > q->seen_mask + 1 )
+   {
+      int cap = 2 * ( q->seen_mask + 1 );
+      int* seen = (int*) calloc( cap, sizeof( int ) );
+      if( !seen )
+      {
+         *ok = false;
+         return false;
+      }
+
+      for( int k = 0; k <= q->seen_mask; ++k )
+      {
+         if( q->seen[ k ] == 0 ) continue;
+         unsigned h = hash_key( q->seen[ k ] ) & ( cap - 1 );
+         while( seen[ h ] != 0 ) h = ( h + 1 ) & ( cap - 1 );
+         seen[ h ] = q->seen[ k ];
+      }
+      free( q->seen );
+      q->seen = seen;
+      q->seen_mask = cap - 1;
+   }
+
+   unsigned h = hash_key( x + 1 ) & q->seen_mask;
+   for( ; q->seen[ h ] != 0; h = ( h + 1 ) & q->seen_mask )
+   {
+      if( q->seen[ h ] == x + 1 ) return false;
+   }
+   q->seen[ h ] = x + 1;
+   ++q->seen_len;
+   return true;
+}
+
+// vacía el conjunto de vistos. Sólo se borran las casillas usadas, así que el costo es
+// proporcional al último BFS y no al tamaño que alcanzó la tabla.
+static void slot_forget( QuerySlot* q )
+{
+   if( q->seen_len == 0 ) return;
+
+   if( 4 * q->seen_len > q->seen_mask )
+   {
+      memset( q->seen, 0, ( q->seen_mask + 1 ) * sizeof( int ) );
+   }
+   else
+   {
+      // todo vértice visto es |root| o está en la cola (en las posiciones pares, antes de
+      // |tail|); como cada uno está en la tabla, su búsqueda termina aunque pase por casillas
+      // ya borradas
+      for( int k = -2; k < q->tail; k += 2 )
+      {
+         int x = ( k < 0 ? q->root : q->queue[ k ] ) + 1;
+         unsigned h = hash_key( x ) & q->seen_mask;
+         while( q->seen[ h ] != x ) h = ( h + 1 ) & q->seen_mask;
+         q->seen[ h ] = 0;
+      }
+   }
+   q->seen_len = 0;
+}
+
+static bool slot_push( QuerySlot* q, int x, int depth, bool* ok )
+{
+   if( q->tail + 2 > q->queue_cap )
+   {
+      int cap = q->queue_cap > 0 ? 2 * q->queue_cap : 64;
+      int* queue = (int*) realloc( q->queue, cap * sizeof( int ) );
+      if( !queue )
+      {
+         *ok = false;
+         return false;
+      }
+      q->queue = queue;
+      q->queue_cap = cap;
+   }
+   q->queue[ q->tail++ ] = x;
+   q->queue[ q->tail++ ] = depth;
+   return true;
+}
+
+// avanza una etapa de la consulta de |q|; devuelve true si la consulta terminó, con la
+// respuesta en |*answer|
+static bool slot_step( Graph* g, const CSR* out, const GraphQuery* query, QuerySlot* q, bool* answer, bool* ok )
+{
+   switch( q->stage )
+   {
+   case QUERY_KEYS:
+      if( !g->keys )
+      {
+         q->u = find_key( g, query->start );
+         q->v = find_key( g, query->finish );
+         q->stage = QUERY_VERIFY;
+         return false;
+      }
+      q->hu = hash_key( query->start ) & g->keys_mask;
+      q->hv = hash_key( query->finish ) & g->keys_mask;
+      __builtin_prefetch( &g->keys[ q->hu ] );
+      __builtin_prefetch( &g->keys[ q->hv ] );
+      q->stage = QUERY_PROBE;
+      return false;
+
+   case QUERY_PROBE:
+      q->u = g->keys[ q->hu ] - 1;
+      q->v = g->keys[ q->hv ] - 1;
+      if( q->u >= 0 ) __builtin_prefetch( &g->vertices[ q->u ] );
+      if( q->v >= 0 ) __builtin_prefetch( &g->vertices[ q->v ] );
+      q->stage = QUERY_VERIFY;
+      return false;
+
+   case QUERY_VERIFY:
+      if( g->keys )
+      {
+         // la primera casilla casi siempre es la buena; si no, se sigue la secuencia normal
+         if( q->u < 0 || g->vertices[ q->u ].data != query->start ) q->u = find_key( g, query->start );
+         if( q->v < 0 || g->vertices[ q->v ].data != query->finish ) q->v = find_key( g, query->finish );
+      }
+      if( q->u == -1 || q->v == -1 )
+      {
+         *answer = false;
+         return true;
+      }
+
+      if( query->type == eGraphQuery_IS_NEIGHBOR )
+      {
+         q->list = g->vertices[ q->u ].neighbors;
+         if( !q->list )
+         {
+            *answer = false;
+            return true;
+         }
+         __builtin_prefetch( q->list );
+         q->stage = QUERY_LIST;
+         return false;
+      }
+
+      if( q->u == q->v || query->max_hops <= 0 )
+      {
+         *answer = q->u == q->v;
+         return true;
+      }
+      slot_forget( q );
+      q->head = q->tail = 0;
+      q->root = q->u;
+      slot_see( q, q->u, ok );
+      q->x = q->u;
+      q->depth = 0;
+      __builtin_prefetch( &out->start[ q->x ] );
+      q->stage = QUERY_BFS_ADJ;
+      return !*ok;
+
+   case QUERY_LIST:
+      q->node = q->list->first;
+      if( !q->node )
+      {
+         *answer = false;
+         return true;
+      }
+      __builtin_prefetch( q->node );
+      q->stage = QUERY_NODE;
+      return false;
+
+   case QUERY_NODE:
+      if( q->node->data.index == q->v )
+      {
+         *answer = true;
+         return true;
+      }
+      q->node = q->node->next;
+      if( !q->node )
+      {
+         *answer = false;
+         return true;
+      }
+      __builtin_prefetch( q->node );
+      return false;
+
+   case QUERY_BFS_ADJ:
+      q->begin = out->start[ q->x ];
+      q->end = out->start[ q->x + 1 ];
+      __builtin_prefetch( &out->adj[ q->begin ] );
+      q->stage = QUERY_BFS_SCAN;
+      return false;
+
+   case QUERY_BFS_SCAN:
+      for( int e = q->begin; e < q->end; ++e )
+      {
+         int w = out->adj[ e ].index;
+         if( w == q->v )
+         {
+            *answer = true;
+            return true;
+         }
+         if( q->depth + 1 < query->max_hops && slot_see( q, w, ok ) ) slot_push( q, w, q->depth + 1, ok );
+         if( !*ok ) return true;
+      }
+
+      if( q->head == q->tail )
+      {
+         *answer = false;
+         return true;
+      }
+      q->x = q->queue[ q->head++ ];
+      q->depth = q->queue[ q->head++ ];
+      __builtin_prefetch( &out->start[ q->x ] );
+      q->stage = QUERY_BFS_ADJ;
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Resuelve un lote de consultas pequeñas intercalando hasta QUERY_GROUP a la vez.
+ *
+ * Cada consulta es una máquina de estados: en cada paso usa la memoria que pidió en el paso
+ * anterior, pide con __builtin_prefetch() la que necesitará (casilla de la tabla de llaves,
+ * vértice, nodo de la lista, adyacencia en el CSR) y cede el turno a la siguiente consulta del
+ * grupo. Así, mientras una consulta espera a la memoria, las demás avanzan, en lugar de esperar
+ * cada acceso uno por uno. Conviene en grafos que no caben en la caché.
+ *
+ * @param g       El grafo.
+ * @param queries Las consultas.
+ * @param n       Número de consultas.
+ * @param answers Arreglo de |n| elementos para las respuestas. Una consulta con vértices que no
+ *                existen responde false.
+ *
+ * @return El número de respuestas true, o -1 si no hubo memoria.
+ */
+int Graph_RunQueries( Graph* g, const GraphQuery queries[], int n, bool answers[] )
+{
+   const CSR* out = NULL;
+   for( int k = 0; k < n && !out; ++k )
+   {
+      if( queries[ k ].type == eGraphQuery_WITHIN_HOPS && !( out = out_edges( g ) ) ) return -1;
+   }
+
+   QuerySlot slots[ QUERY_GROUP ];
+   memset( slots, 0, sizeof( slots ) );
+
+   bool ok = true;
+   for( int s = 0; s < QUERY_GROUP && ok; ++s )
+   {
+      slots[ s ].seen_mask = 15;
+      ok = ( slots[ s ].seen = (int*) calloc( 16, sizeof( int ) ) ) != NULL;
+   }
+
+   int next = 0;
+   int active = 0;
+   for( int s = 0; s < QUERY_GROUP; ++s )
+   {
+      slots[ s ].query = next < n ? next++ : -1;
+      if( slots[ s ].query != -1 ) ++active;
+   }
+
+   int count = 0;
+   while( active > 0 && ok )
+   {
+      for( int s = 0; s < QUERY_GROUP && ok; ++s )
+      {
+         QuerySlot* q = &slots[ s ];
+         if( q->query == -1 ) continue;
+
+         bool answer = false;
+         if( !slot_step( g, out, &queries[ q->query ], q, &answer, &ok ) ) continue;
+
+         answers[ q->query ] = answer;
+         if( answer ) ++count;
+
+         // la casilla toma la siguiente consulta
+         q->stage = QUERY_KEYS;
+         q->query = next < n ? next++ : -1;
+         if( q->query == -1 ) --active;
+      }
+   }
+
+   for( int s = 0; s < QUERY_GROUP; ++s )
+   {
+      free( slots[ s ].seen );
+      free( slots[ s ].queue );
+   }
+
+   return ok ? count : -1;
 }
 
-void Vertex_SetDistance( Vertex* v, int distance )
+
+//----------------------------------------------------------------------
+//                           Servidor de consultas: 
+//----------------------------------------------------------------------
+
+/** Operaciones del protocolo de Graph_Serve().
+ */
+typedef enum
 {
-    v->distance = distance;
-}
+   eServeOp_NEIGHBORS = 1, ///< vecinos de |a|: (llave, peso) por vecino
+   eServeOp_WEIGHT,        ///< peso de la arista |a| -> |b| en |value|
+   eServeOp_PATH,          ///< ruta más rápida de |a| a |b|: costo en |value|; (llave, peso del tramo) por vértice
+   eServeOp_ISOCHRONE,     ///< vértices a distancia <= |x| de |a|: (llave, distancia) por vértice
+} eServeOp;
 
-int Vertex_GetDistance( Vertex* v )
+/** Resultado de una petición.
+ */
+typedef enum
 {
-    return v->distance;
-}
+   eServeStatus_OK,
+   eServeStatus_NOT_FOUND,   ///< el vértice, la arista o la ruta no existe
+   eServeStatus_BAD_REQUEST, ///< operación desconocida
+   eServeStatus_ERROR,       ///< no hubo memoria
+} eServeStatus;
 
-void Vertex_SetPredecessor( Vertex* v, int predecessor_idx )
+/**
+ * @brief Petición (20 bytes, en el orden de bytes del equipo).
+ */
+typedef struct
 {
-    v->predecessor = predecessor_idx;
-}
+   uint32_t id;         ///< lo elige el cliente; se repite en la respuesta
+   uint8_t op;          ///< eServeOp
+   uint8_t reserved[ 3 ];
+   int32_t a;           ///< llave del primer vértice
+   int32_t b;           ///< llave del segundo vértice
+   float x;             ///< parámetro real (presupuesto de la isócrona)
+} ServeRequest;
 
-int Vertex_GetPredecessor( Vertex* v )
+/**
+ * @brief Encabezado de una respuesta (16 bytes); le siguen |count| ServeItem.
+ */
+typedef struct
 {
-    return v->predecessor;
-}
+   uint32_t id;
+   uint8_t status;      ///< eServeStatus
+   uint8_t reserved[ 3 ];
+   uint32_t count;
+   float value;
+} ServeResponse;
 
+typedef struct
+{
+   int32_t key;
+   float value;
+} ServeItem;
 
+#ifdef __linux__
 
-/**
- * @brief Inserta una relación de adyacencia del vértice |start| hacia el vértice |finish|.
- *
- * @param g      El grafo.
- * @param start  Vértice de salida (el dato)
- * @param finish Vertice de llegada (el dato)
- *
- * @return false si uno o ambos vértices no existen; true si la relación se creó con éxito.
- *
- * @pre El grafo no puede estar vacío.
- */
-bool Graph_AddEdge( Graph* g, int start, int finish )
+// eventos que se atienden por cada llamada a epoll_wait()
+#define SERVE_EVENTS 64
+
+// bytes que se leen de una conexión a la vez
+#define SERVE_READ_CHUNK 65536
+
+// si una conexión acumula más bytes sin enviar, se deja de leerla hasta que el cliente los reciba
+#define SERVE_MAX_PENDING ( 1 << 20 )
+
+typedef struct ServeConn
 {
-   assert( g->len > 0 );
+   int fd;
+   struct ServeConn* prev; ///< lista de conexiones abiertas
+   struct ServeConn* next;
+   uint8_t* in;      ///< bytes recibidos que aún no forman peticiones completas
+   size_t in_len;
+   size_t in_cap;
+   uint8_t* out;     ///< respuestas por enviar
+   size_t out_len;
+   size_t out_cap;
+} ServeConn;
 
-   // obtenemos los índices correspondientes:
-   int start_idx = find( g->vertices, g->size, start );
-   int finish_idx = find( g->vertices, g->size, finish );
+typedef struct
+{
+   Graph* graph;
+   RouteCache* routes;
+   int* path;        ///< Graph_GetLen() índices
+   Data* reach;      ///< Graph_GetLen() resultados de la isócrona
+} ServeContext;
 
-   DBG_PRINT( "AddEdge(): from:%d (with index:%d), to:%d (with index:%d)\n", start, start_idx, finish, finish_idx );
+static volatile sig_atomic_t serve_stop = 0;
 
-   if( start_idx == -1 || finish_idx == -1 ) return false;
-   // uno o ambos vértices no existen
+static void serve_on_signal( int sig )
+{
+   (void) sig;
+   serve_stop = 1;
+}
 
-   insert( &g->vertices[ start_idx ], finish_idx, 0.0 );
-   // insertamos la arista start-finish
+static bool buffer_reserve( uint8_t** buf, size_t* cap, size_t need )
+{
+   if( need <= *cap ) return true;
 
-   if( g->type == eGraphType_UNDIRECTED ) insert( &g->vertices[ finish_idx ], start_idx, 0.0 );
-   // si el grafo no es dirigido, entonces insertamos la arista finish-start
+   size_t new_cap = *cap > 0 ? *cap : 4096;
+   while( new_cap < need ) new_cap *= 2;
+
+   uint8_t* p = (uint8_t*) realloc( *buf, new_cap );
+   if( !p ) return false;
 
+   *buf = p;
+   *cap = new_cap;
    return true;
 }
 
+// agrega una respuesta con lugar para |count| elementos; devuelve dónde escribirlos, o NULL
+// si no hubo memoria
+static ServeItem* serve_reply( ServeConn* c, uint32_t id, eServeStatus status, uint32_t count, float value )
+{
+   size_t size = sizeof( ServeResponse ) + count * sizeof( ServeItem );
+   if( !buffer_reserve( &c->out, &c->out_cap, c->out_len + size ) ) return NULL;
 
-int Graph_GetLen( Graph* g )
+   ServeResponse r = { id, (uint8_t) status, { 0 }, count, value };
+   memcpy( &c->out[ c->out_len ], &r, sizeof( r ) );
+
+   ServeItem* items = (ServeItem*) &c->out[ c->out_len + sizeof( r ) ];
+   // |out| viene de malloc() y las respuestas miden múltiplos de 4 bytes: está alineado
+   c->out_len += size;
+   return items;
+}
+
+// atiende una petición; false si no hubo memoria para la respuesta
+static bool serve_request( ServeContext* ctx, ServeConn* c, const ServeRequest* req )
 {
-   return g->len;
+   Graph* g = ctx->graph;
+   ServeItem* items;
+
+   switch( req->op )
+   {
+   case eServeOp_NEIGHBORS:
+   {
+      int idx = find_key( g, req->a );
+      const CSR* out = out_edges( g );
+      if( idx == -1 || !out ) return serve_reply( c, req->id, idx == -1 ? eServeStatus_NOT_FOUND : eServeStatus_ERROR, 0, 0.0f );
+
+      int degree = csr_degree( out, idx );
+      if( !( items = serve_reply( c, req->id, eServeStatus_OK, degree, 0.0f ) ) ) return false;
+
+      for( int k = 0; k < degree; ++k )
+      {
+         const Data* d = &out->adj[ out->start[ idx ] + k ];
+         items[ k ] = (ServeItem){ g->vertices[ d->index ].data, d->weight };
+      }
+      return true;
+   }
+
+   case eServeOp_WEIGHT:
+   {
+      if( find_key( g, req->a ) == -1 || find_key( g, req->b ) == -1 )
+      {
+         return serve_reply( c, req->id, eServeStatus_NOT_FOUND, 0, 0.0f );
+      }
+      // así nunca se llega a Graph_GetWeight() con un grafo vacío
+
+      double w = Graph_GetWeight( g, req->a, req->b );
+      return serve_reply( c, req->id, w < 0.0 ? eServeStatus_NOT_FOUND : eServeStatus_OK, 0, (float) w );
+   }
+
+   case eServeOp_PATH:
+   {
+      if( find_key( g, req->a ) == -1 || find_key( g, req->b ) == -1 )
+      {
+         return serve_reply( c, req->id, eServeStatus_NOT_FOUND, 0, 0.0f );
+      }
+
+      float cost;
+      int len = RouteCache_Query( ctx->routes, req->a, req->b, eRouteQuery_FASTEST, ctx->path, &cost );
+      const CSR* out = out_edges( g );
+      if( len <= 0 || !out )
+      {
+         return serve_reply( c, req->id, len == 0 ? eServeStatus_NOT_FOUND : eServeStatus_ERROR, 0, 0.0f );
+      }
+      // los vértices existen: -1 sólo puede ser falta de memoria
+
+      if( !( items = serve_reply( c, req->id, eServeStatus_OK, len, cost ) ) ) return false;
+
+      for( int k = 0; k < len; ++k )
+      {
+         int v = ctx->path[ k ];
+         float leg = k == 0 ? 0.0f : out->adj[ csr_find_edge( out, ctx->path[ k - 1 ], v ) ].weight;
+         items[ k ] = (ServeItem){ g->vertices[ v ].data, leg };
+      }
+      return true;
+   }
+
+   case eServeOp_ISOCHRONE:
+   {
+      if( find_key( g, req->a ) == -1 ) return serve_reply( c, req->id, eServeStatus_NOT_FOUND, 0, 0.0f );
+
+      int count = Graph_ReachableWithin( g, req->a, req->x, ctx->reach );
+      if( count < 0 ) return serve_reply( c, req->id, eServeStatus_ERROR, 0, 0.0f );
+
+      if( !( items = serve_reply( c, req->id, eServeStatus_OK, count, 0.0f ) ) ) return false;
+
+      for( int k = 0; k < count; ++k )
+      {
+         items[ k ] = (ServeItem){ g->vertices[ ctx->reach[ k ].index ].data, ctx->reach[ k ].weight };
+      }
+      return true;
+   }
+
+   default:
+      return serve_reply( c, req->id, eServeStatus_BAD_REQUEST, 0, 0.0f );
+   }
 }
 
+// envía lo que se pueda de las respuestas pendientes; false si la conexión falló
+static bool serve_flush( ServeConn* c )
+{
+   size_t pos = 0;
+   while( pos < c->out_len )
+   {
+      ssize_t sent = send( c->fd, &c->out[ pos ], c->out_len - pos, MSG_NOSIGNAL );
+      if( sent < 0 )
+      {
+         if( errno == EAGAIN || errno == EWOULDBLOCK ) break;
+         if( errno == EINTR ) continue;
+         return false;
+      }
+      pos += sent;
+   }
 
-/**
- * @brief Devuelve la información asociada al vértice indicado.
- *
- * @param g          Un grafo.
- * @param vertex_idx El índice del vértice del cual queremos conocer su información.
- *
- * @return La información asociada al vértice vertex_idx.
- */
-Item Graph_GetDataByIndex( const Graph* g, int vertex_idx )
+   // lo que no se envió pasa al inicio, para que |out| no crezca con el tráfico total de un
+   // cliente que nunca deja vacío el buffer
+   if( pos > 0 )
+   {
+      memmove( c->out, &c->out[ pos ], c->out_len - pos );
+      c->out_len -= pos;
+   }
+   return true;
+}
+
+// atiende todas las peticiones completas que hay en |in| (el cliente puede mandar varias sin
+// esperar respuesta)
+static bool serve_pending( ServeContext* ctx, ServeConn* c )
 {
-   assert( 0 <= vertex_idx && vertex_idx < g->len );
+   size_t pos = 0;
+   while( c->in_len - pos >= sizeof( ServeRequest ) && c->out_len < SERVE_MAX_PENDING )
+   {
+      ServeRequest req;
+      memcpy( &req, &c->in[ pos ], sizeof( req ) );
+      pos += sizeof( req );
 
-   return g->vertices[ vertex_idx ].data;
+      if( !serve_request( ctx, c, &req ) ) return false;
+   }
+
+   memmove( c->in, &c->in[ pos ], c->in_len - pos );
+   c->in_len -= pos;
+   return true;
 }
 
-/**
- * @brief Devuelve una referencia al vértice indicado.
- *
- * Esta función puede ser utilizada con las operaciones @see Vertex_Start(), @see Vertex_End(), @see Vertex_Next().
- *
- * @param g          Un grafo
- * @param vertex_idx El índice del vértice del cual queremos devolver la referencia.
- *
- * @return La referencia al vértice vertex_idx.
- */
-Vertex* Graph_GetVertexByIndex( const Graph* g, int vertex_idx )
+static void serve_close( int epoll_fd, ServeConn** list, ServeConn* c )
 {
-   assert( 0 <= vertex_idx && vertex_idx < g->len );
+   if( c->prev ) c->prev->next = c->next; else *list = c->next;
+   if( c->next ) c->next->prev = c->prev;
 
-   return &(g->vertices[ vertex_idx ] );
+   epoll_ctl( epoll_fd, EPOLL_CTL_DEL, c->fd, NULL );
+   close( c->fd );
+   free( c->in );
+   free( c->out );
+   free( c );
 }
 
-/**
- * @brief Inserta una relación de adyacencia del vértice |start| hacia el vértice |finish| con un peso dado.
- *
- * @param g      El grafo.
- * @param start  Vértice de salida (el dato)
- * @param finish Vertice de llegada (el dato)
- * @param weight Peso de la arista.
- *
- * @return false si uno o ambos vértices no existen; true si la relación se creó con éxito.
- *
- * @pre El grafo no puede estar vacío.
- */
-bool Graph_AddWeightedEdge( Graph* g, int start, int finish, float weight )
+// ajusta los eventos que interesan de la conexión según tenga o no respuestas pendientes
+static void serve_watch( int epoll_fd, ServeConn* c )
 {
-   assert( g->len > 0 );
+   size_t pending = c->out_len;
 
-   // obtenemos los índices correspondientes:
-   int start_idx = find( g->vertices, g->size, start );
-   int finish_idx = find( g->vertices, g->size, finish );
+   struct epoll_event ev;
+   ev.events = ( pending < SERVE_MAX_PENDING ? EPOLLIN : 0 ) | ( pending > 0 ? EPOLLOUT : 0 );
+   ev.data.ptr = c;
+   epoll_ctl( epoll_fd, EPOLL_CTL_MOD, c->fd, &ev );
+}
 
-   DBG_PRINT( "AddWeightedEdge(): from:%d (with index:%d), to:%d (with index:%d), weight:%f\n", start, start_idx, finish, finish_idx, weight );
+// atiende los eventos de una conexión; false si hay que cerrarla
+static bool serve_events( ServeContext* ctx, int epoll_fd, ServeConn* c, uint32_t events )
+{
+   if( events & ( EPOLLERR | EPOLLHUP ) && !( events & EPOLLIN ) ) return false;
 
-   if( start_idx == -1 || finish_idx == -1 ) return false;
-   // uno o ambos vértices no existen
+   if( events & EPOLLIN )
+   {
+      if( !buffer_reserve( &c->in, &c->in_cap, c->in_len + SERVE_READ_CHUNK ) ) return false;
 
-   insert( &g->vertices[ start_idx ], finish_idx, weight );
-   // insertamos la arista start-finish con el peso especificado
+      ssize_t got = recv( c->fd, &c->in[ c->in_len ], SERVE_READ_CHUNK, 0 );
+      if( got == 0 ) return false;
+      if( got < 0 ) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
 
-   if( g->type == eGraphType_UNDIRECTED ) insert( &g->vertices[ finish_idx ], start_idx, weight );
-   // si el grafo no es dirigido, entonces insertamos la arista finish-start con el peso especificado
+      c->in_len += got;
+   }
 
+   // si el cliente ya recibió respuestas, se atiende también lo que quedó en |in| mientras se
+   // pausaba la lectura
+   do
+   {
+      if( !serve_pending( ctx, c ) || !serve_flush( c ) ) return false;
+   } while( c->in_len >= sizeof( ServeRequest ) && c->out_len < SERVE_MAX_PENDING );
+
+   serve_watch( epoll_fd, c );
    return true;
 }
 
+// deja libre la ruta de |addr| para bind(): si tiene un socket abandonado por un servidor
+// anterior lo borra; false si es otro tipo de archivo o si un servidor todavía atiende en ella
+static bool serve_claim_path( const struct sockaddr_un* addr )
+{
+   struct stat st;
+   if( lstat( addr->sun_path, &st ) != 0 ) return errno == ENOENT;
+   if( !S_ISSOCK( st.st_mode ) ) return false;
+
+   int probe = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+   if( probe == -1 ) return false;
+
+   bool live = connect( probe, (const struct sockaddr*) addr, sizeof( *addr ) ) == 0 || errno == EAGAIN;
+   // EAGAIN: el servidor existe pero su cola de conexiones está llena
+   close( probe );
+
+   return !live && unlink( addr->sun_path ) == 0;
+}
+
 /**
- * @brief Indica si un vértice tiene una relación de adyacencia con otro en un grafo no dirigido.
+ * @brief Atiende consultas sobre el grafo en un socket Unix hasta recibir SIGINT o SIGTERM.
  *
- * @param g     El grafo.
- * @param dest  Vértice de llegada (el dato)
- * @param src   Vértice de salida (el dato)
+ * Protocolo: el cliente manda peticiones ServeRequest de 20 bytes y recibe, en el mismo orden,
+ * un ServeResponse de 16 bytes seguido de |count| ServeItem de 8 bytes. Puede mandar muchas
+ * peticiones sin esperar las respuestas (pipelining); el campo |id| permite relacionarlas.
+ * Todos los campos van en el orden de bytes del equipo, ya que cliente y servidor comparten
+ * la máquina.
  *
- * @return true si dest es vecino de src en un grafo no dirigido, false en cualquier otro caso.
+ * Un solo hilo atiende todas las conexiones con epoll; las rutas se guardan en una caché
+ * (RouteCache) así que las consultas repetidas no vuelven a buscar.
+ *
+ * Mientras atiende, SIGINT y SIGTERM tienen su propio manejador; al regresar se restauran los
+ * manejadores y la máscara de señales anteriores.
+ *
+ * @param g    El grafo, ya construido. No se modifica mientras se atiende.
+ * @param path Ruta del socket. Si ya existe un socket ahí sin servidor que lo atienda, se
+ *             reemplaza; cualquier otro archivo no se toca.
+ *
+ * @return 0 al terminar normalmente, o -1 si la ruta está ocupada, no se pudo crear el socket o
+ * no hubo memoria.
  */
-bool Graph_IsNeighborOf( Graph* g, int dest, int src )
+int Graph_Serve( Graph* g, const char* path )
 {
-   assert( g->len > 0 );
+   struct sockaddr_un addr;
+   memset( &addr, 0, sizeof( addr ) );
+   addr.sun_family = AF_UNIX;
+   if( strlen( path ) >= sizeof( addr.sun_path ) ) return -1;
+   strcpy( addr.sun_path, path );
 
-   // Obtenemos los índices correspondientes:
-   int src_idx = find( g->vertices, g->size, src );
-   int dest_idx = find( g->vertices, g->size, dest );
+   ServeContext ctx;
+   ctx.graph = g;
+   ctx.routes = Graph_NewRouteCache( g, 4096 );
+   ctx.path = (int*) malloc( ( g->len > 0 ? g->len : 1 ) * sizeof( int ) );
+   ctx.reach = (Data*) malloc( ( g->len > 0 ? g->len : 1 ) * sizeof( Data ) );
 
-   if (src_idx == -1 || dest_idx == -1) {
-      return false; // Uno o ambos vértices no existen
-   }
+   int listen_fd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+   int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+   ServeConn* conns = NULL;
+   bool bound = false;
+   int ret = -1;
 
-   // Verificamos si src tiene una relación de adyacencia con dest
-   Vertex* src_vertex = &g->vertices[src_idx];
-   if (src_vertex->neighbors) {
-      for (List_Cursor_front(src_vertex->neighbors);
-           !List_Cursor_end(src_vertex->neighbors);
-           List_Cursor_next(src_vertex->neighbors)) {
-         Data d = List_Cursor_get(src_vertex->neighbors);
-         if (d.index == dest_idx) {
-            return true; // dest es vecino de src
+   struct epoll_event ev;
+   ev.events = EPOLLIN;
+   ev.data.ptr = NULL;
+   // NULL identifica al socket que acepta conexiones
+
+   if( ctx.routes && ctx.path && ctx.reach && listen_fd != -1 && epoll_fd != -1 &&
+       serve_claim_path( &addr ) &&
+       ( bound = bind( listen_fd, (struct sockaddr*) &addr, sizeof( addr ) ) == 0 ) &&
+       listen( listen_fd, SOMAXCONN ) == 0 &&
+       epoll_ctl( epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev ) == 0 )
+   {
+      // las señales se bloquean y sólo se reciben dentro de epoll_pwait(); así no se pierde una
+      // que llegue entre la revisión de |serve_stop| y la espera
+      sigset_t block, old_mask, wait_mask;
+      sigemptyset( &block );
+      sigaddset( &block, SIGINT );
+      sigaddset( &block, SIGTERM );
+      pthread_sigmask( SIG_BLOCK, &block, &old_mask );
+
+      wait_mask = old_mask;
+      sigdelset( &wait_mask, SIGINT );
+      sigdelset( &wait_mask, SIGTERM );
+
+      struct sigaction sa, old_int, old_term;
+      memset( &sa, 0, sizeof( sa ) );
+      sa.sa_handler = serve_on_signal;
+      sigemptyset( &sa.sa_mask );
+      sigaction( SIGINT, &sa, &old_int );
+      sigaction( SIGTERM, &sa, &old_term );
+
+      out_edges( g );
+      // el índice CSR se construye una sola vez, antes de atender
+
+      ret = 0;
+      serve_stop = 0;
+
+      struct epoll_event events[ SERVE_EVENTS ];
+      while( !serve_stop )
+      {
+         int n = epoll_pwait( epoll_fd, events, SERVE_EVENTS, -1, &wait_mask );
+         if( n < 0 )
+         {
+            if( errno == EINTR ) continue;
+            ret = -1;
+            break;
+         }
+
+         for( int k = 0; k < n; ++k )
+         {
+            ServeConn* c = (ServeConn*) events[ k ].data.ptr;
+
+            if( !c )
+            {
+               int fd;
+               while( ( fd = accept4( listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) != -1 )
+               {
+                  ServeConn* conn = (ServeConn*) calloc( 1, sizeof( ServeConn ) );
+                  struct epoll_event cev;
+                  cev.events = EPOLLIN;
+                  cev.data.ptr = conn;
+
+                  if( !conn || epoll_ctl( epoll_fd, EPOLL_CTL_ADD, fd, &cev ) != 0 )
+                  {
+                     free( conn );
+                     close( fd );
+                     continue;
+                  }
+                  conn->fd = fd;
+                  conn->next = conns;
+                  if( conns ) conns->prev = conn;
+                  conns = conn;
+               }
+               continue;
+            }
+
+            if( !serve_events( &ctx, epoll_fd, c, events[ k ].events ) ) serve_close( epoll_fd, &conns, c );
          }
       }
+
+      sigaction( SIGINT, &old_int, NULL );
+      sigaction( SIGTERM, &old_term, NULL );
+      pthread_sigmask( SIG_SETMASK, &old_mask, NULL );
    }
 
-   return false; // No se encontró una relación de adyacencia entre src y dest
+   while( conns ) serve_close( epoll_fd, &conns, conns );
+   if( epoll_fd != -1 ) close( epoll_fd );
+   if( listen_fd != -1 ) close( listen_fd );
+   if( bound ) unlink( path );
+   if( ctx.routes ) RouteCache_Delete( &ctx.routes );
+   free( ctx.path );
+   free( ctx.reach );
+
+   return ret;
+}
+
+#else
+
+int Graph_Serve( Graph* g, const char* path )
+{
+   (void) g;
+   (void) path;
+   return -1;
+   // sólo está disponible en Linux (usa epoll)
 }
 
+#endif
+
 
 #define MAX_VERTICES 5
 
 
-int main()
+int main(int argc, char* argv[])
 {
     // Crear un grafo para representar la red de aeropuertos
     Graph *grafo = Graph_New(5, eGraphType_DIRECTED); // Utilizamos un digraph
 
     // Crear aeropuertos con información válida
-    Airport airport_MEX = {100, "MEX", "MEXICO", "MEXICO CITY", "AEROPUERTO INTERNACIONAL BENITO JUÁREZ", -6};
-    Airport airport_LHR = {120, "LHR", "UNITED KINGDOM", "LONDON", "LONDON HEATHROW", 0}; // Ajusta el UTC Time
-    Airport airport_MAD = {130, "MAD", "SPAIN", "MADRID", "MADRID-BARAJAS", 1};          // Ajusta el UTC Time
-    Airport airport_FRA = {140, "FRA", "GERMANY", "FRANKFURT", "FLUGHAFEN FRANKFURT AM MAIN", 1}; // Ajusta el UTC Time
-    Airport airport_CDG = {150, "CDG", "FRANCE", "PARIS", "CHARLES DE GAULLE", 1};            // Ajusta el UTC Time
+    Airport airport_MEX = {100, "MEX", "MEXICO", "MEXICO CITY", "AEROPUERTO INTERNACIONAL BENITO JUÁREZ", -6, 19.4361f, -99.0719f};
+    Airport airport_LHR = {120, "LHR", "UNITED KINGDOM", "LONDON", "LONDON HEATHROW", 0, 51.4700f, -0.4543f}; // Ajusta el UTC Time
+    Airport airport_MAD = {130, "MAD", "SPAIN", "MADRID", "MADRID-BARAJAS", 1, 40.4983f, -3.5676f};          // Ajusta el UTC Time
+    Airport airport_FRA = {140, "FRA", "GERMANY", "FRANKFURT", "FLUGHAFEN FRANKFURT AM MAIN", 1, 50.0379f, 8.5622f}; // Ajusta el UTC Time
+    Airport airport_CDG = {150, "CDG", "FRANCE", "PARIS", "CHARLES DE GAULLE", 1, 49.0097f, 2.5479f};            // Ajusta el UTC Time
 
     // Agregar los aeropuertos al grafo
-    Graph_AddVertex(grafo, airport_MEX);
-    Graph_AddVertex(grafo, airport_LHR);
-    Graph_AddVertex(grafo, airport_MAD);
-    Graph_AddVertex(grafo, airport_FRA);
-    Graph_AddVertex(grafo, airport_CDG);
+    Graph_AddVertex(grafo, &airport_MEX);
+    Graph_AddVertex(grafo, &airport_LHR);
+    Graph_AddVertex(grafo, &airport_MAD);
+    Graph_AddVertex(grafo, &airport_FRA);
+    Graph_AddVertex(grafo, &airport_CDG);
 
     // Agregar las rutas y tiempos de vuelo (esto es solo un ejemplo, ajusta los valores)
     Graph_AddWeightedEdge(grafo, 100, 120, 9.00);
@@ -601,28 +7594,127 @@ int main()
     Graph_AddWeightedEdge(grafo, 130, 150, 1.50);
     Graph_AddWeightedEdge(grafo, 140, 150, 1.20);
 
+    // Con --serve <socket> el programa atiende consultas de otros procesos en lugar de preguntar
+    // al usuario
+    if (argc == 3 && strcmp(argv[1], "--serve") == 0)
+    {
+        printf("Atendiendo consultas en %s (Ctrl+C para terminar)\n", argv[2]);
+        fflush(stdout);
+        int ret = Graph_Serve(grafo, argv[2]);
+        if (ret != 0) fprintf(stderr, "No se pudo atender en %s\n", argv[2]);
+        Graph_Delete(&grafo);
+        return ret == 0 ? 0 : 1;
+    }
+
     // Imprimir el grafo
     Graph_Print(grafo, 1);
 
-    // Solicitar al usuario un código de vuelo
-int flightCode;
+    // Distancias (en número de vuelos) desde MEX
+    Graph_BFS_DirectionOptimizing(grafo, 100);
+    printf("Vuelos necesarios desde MEX: ");
+    for (int i = 0; i < Graph_GetLen(grafo); ++i)
+    {
+        Vertex* v = Graph_GetVertexByIndex(grafo, i);
+        printf("%s(%d) ", v->airport_info.iata_code, Vertex_GetDistance(v));
+    }
+    printf("\n");
+
+    // Las rutas de ida sin regreso dejan a los pasajeros varados
+    int scc[MAX_VERTICES];
+    printf("Componentes fuertemente conexas: %d\n\n",
+           Graph_StronglyConnectedComponents(grafo, scc, NULL));
+
+    // Vuelos que llegan a CDG
+    Vertex* cdg = Graph_GetVertexByIndex(grafo, 4);
+    printf("Vuelos que llegan a %s: ", cdg->airport_info.iata_code);
+    for (Vertex_InStart(grafo, cdg); !Vertex_InEnd(cdg); Vertex_InNext(cdg))
+    {
+        Data d = Vertex_GetInNeighborIndex(cdg);
+        printf("%s(W:%.2f) ", Graph_GetVertexByIndex(grafo, d.index)->airport_info.iata_code, d.weight);
+    }
+    printf("\n\n");
+
+    // Itinerarios alternativos de MEX a CDG, del más corto al más largo
+    Path itinerarios[3];
+    int num_itinerarios = Graph_KShortestPaths(grafo, 100, 150, 3, itinerarios);
+    for (int i = 0; i < num_itinerarios; ++i)
+    {
+        printf("Itinerario %d (%.2f h): ", i + 1, itinerarios[i].cost);
+        for (int j = 0; j < itinerarios[i].len; ++j)
+        {
+            printf("%s ", Graph_GetVertexByIndex(grafo, itinerarios[i].vertices[j])->airport_info.iata_code);
+        }
+        printf("\n");
+        Path_Clear(&itinerarios[i]);
+    }
+    printf("\n");
+
+    // Aeropuertos cercanos a un punto (por ejemplo, para salir de otro aeropuerto de la misma región)
+    GeoIndex* geo = Graph_BuildGeoIndex(grafo);
+    if (geo)
+    {
+        Data cercanos[MAX_VERTICES];
+        int num_cercanos = GeoIndex_Within(geo, 48.8566f, 2.3522f, 1000.0f, cercanos); // centro de París
+        printf("Aeropuertos a menos de 1000 km de París: ");
+        for (int i = 0; i < num_cercanos; ++i)
+        {
+            printf("%s (%.0f km) ", Graph_GetVertexByIndex(grafo, cercanos[i].index)->airport_info.iata_code, cercanos[i].weight);
+        }
+        printf("\n");
+
+        num_cercanos = GeoIndex_Nearest(geo, 40.4168f, -3.7038f, 2, cercanos); // centro de Madrid
+        printf("Los 2 aeropuertos más cercanos a Madrid: ");
+        for (int i = 0; i < num_cercanos; ++i)
+        {
+            printf("%s (%.0f km) ", Graph_GetVertexByIndex(grafo, cercanos[i].index)->airport_info.iata_code, cercanos[i].weight);
+        }
+        printf("\n\n");
+
+        GeoIndex_Delete(&geo);
+    }
+
+    // Índice para buscar aeropuertos por código IATA, ciudad o nombre
+    PrefixIndex* indice = Graph_BuildPrefixIndex(grafo);
+
+    // Solicitar al usuario un aeropuerto
+char consulta[65];
 while (1)
 {
-    printf("Ingresa el ID del aeropuerto (100, 120, 130, 140, 150) o -1 para salir: ");
-    scanf("%d", &flightCode);
+    printf("Ingresa el ID del aeropuerto (100, 120, 130, 140, 150), un código IATA o el inicio de una ciudad o nombre (-1 para salir): ");
+    if (scanf("%64s", consulta) != 1)
+    {
+        break;
+    }
 
-    if (flightCode == -1)
+    char* fin;
+    long flightCode = strtol(consulta, &fin, 10);
+    if (*fin == '\0' && flightCode == -1)
     {
         break;
     }
 
-    // Buscar el vértice correspondiente al ID del aeropuerto
+    // Buscar el vértice correspondiente al ID del aeropuerto, o por prefijo si no es un número
     Vertex *flightVertex = NULL;
-    for (int i = 0; i < grafo->len; i++) {
-        if (grafo->vertices[i].airport_info.id == flightCode) {
-            flightVertex = &grafo->vertices[i];
-            break;
+    if (*fin == '\0')
+    {
+        int idx = Graph_FindByKey(grafo, (int) flightCode);
+        if (idx != -1) flightVertex = &grafo->vertices[idx];
+    }
+    else if (indice)
+    {
+        int sugerencias[MAX_VERTICES];
+        int num_sugerencias = PrefixIndex_Search(indice, consulta, eAirportField_ALL, sugerencias, MAX_VERTICES);
+        if (num_sugerencias > 1)
+        {
+            printf("Sugerencias: ");
+            for (int i = 0; i < num_sugerencias; ++i)
+            {
+                const AirportInfo* info = &grafo->vertices[sugerencias[i]].airport_info;
+                printf("%s (%s)%s", info->iata_code, Graph_GetString(grafo, info->city),
+                       i + 1 < num_sugerencias ? ", " : "\n");
+            }
         }
+        if (num_sugerencias > 0) flightVertex = &grafo->vertices[sugerencias[0]];
     }
 
     if (flightVertex)
@@ -631,30 +7723,34 @@ while (1)
         printf("Información completa del aeropuerto %d:\n", flightVertex->airport_info.id);
         printf("ID: %d\n", flightVertex->airport_info.id);
         printf("IATA Code: %s\n", flightVertex->airport_info.iata_code);
-        printf("Country: %s\n", flightVertex->airport_info.country);
-        printf("City: %s\n", flightVertex->airport_info.city);
-        printf("Name: %s\n", flightVertex->airport_info.name);
+        printf("Country: %s\n", Graph_GetString(grafo, flightVertex->airport_info.country));
+        printf("City: %s\n", Graph_GetString(grafo, flightVertex->airport_info.city));
+        printf("Name: %s\n", Graph_GetString(grafo, flightVertex->airport_info.name));
         printf("UTC Time: %d\n", flightVertex->airport_info.utc_time);
 
         // Mostrar códigos IATA de los vecinos
         printf("Códigos IATA de los vecinos: ");
-        Vertex_Start(flightVertex);
-        while (!Vertex_End(flightVertex))
+        if (flightVertex->neighbors) // un aeropuerto sin vuelos de salida no tiene lista
         {
-            Data neighborData = Vertex_GetNeighborIndex(flightVertex);
-            int neighborIndex = neighborData.index;
-            printf("%s(W:%.2f) ", grafo->vertices[neighborIndex].airport_info.iata_code, neighborData.weight);
-            Vertex_Next(flightVertex);
+            Vertex_Start(flightVertex);
+            while (!Vertex_End(flightVertex))
+            {
+                Data neighborData = Vertex_GetNeighborIndex(flightVertex);
+                int neighborIndex = neighborData.index;
+                printf("%s(W:%.2f) ", grafo->vertices[neighborIndex].airport_info.iata_code, neighborData.weight);
+                Vertex_Next(flightVertex);
+            }
         }
         printf("\n");
     }
     else
     {
-        printf("El aeropuerto con código %d no existe en el grafo.\n", flightCode);
+        printf("El aeropuerto %s no existe en el grafo.\n", consulta);
     }
 }
 
-    // Liberar la memoria del grafo
+    // Liberar la memoria del índice y del grafo
+    if (indice) PrefixIndex_Delete(&indice);
     Graph_Delete(&grafo);
 
     return 0;